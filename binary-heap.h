@@ -6,7 +6,9 @@
 #define _BINARY_HEAP_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Binary heap.
  *
@@ -30,6 +32,56 @@
  * Heap operations will regularly allocate memory and all elements
  * must be removed to avoid leaks, by repeatedly using 'pop' until
  * 'is_empty' becomes true.
+ *
+ * The array can optionally be laid out as a B-heap, as described
+ * by P.-H. Kamp in 'You're Doing It Wrong'. When 'BHEAP_PAGE_SHIFT' is
+ * defined before including this file, the array is cut in pages of
+ * 2^BHEAP_PAGE_SHIFT containers, each one storing a whole subtree.
+ * Sifting through the heap then touches one page every
+ * BHEAP_PAGE_SHIFT - 1 levels instead of one page per level once
+ * below the first levels. The first container of each page is unused.
+ * Pages are filled one after the other, so the tree can have up to
+ * BHEAP_PAGE_SHIFT more levels than the usual layout.
+ *
+ * For a page of containers to fit within a 4kB memory page,
+ * 'BHEAP_PAGE_SHIFT' should be 7 on 64 bits systems.
+ *
+ * Two heaps using the same comparison function can be merged.
+ * The entries of the smaller one are appended to the larger one,
+ * then either sifted up one by one or the whole array is rebuilt
+ * in linear time, whichever is expected to be cheaper. Rebuilding
+ * also drops all burnt entries.
+ *
+ * A heap can be bounded to keep at most 'k' elements, for streaming
+ * selection. Once it is full, an offered element is compared once
+ * with the top and rejected unless it comes after it. Otherwise
+ * it replaces the top, which is sifted down. The heap thus keeps
+ * the 'k' last elements in the order of its comparison function:
+ * a min-heap keeps the 'k' largest priorities. Offering elements
+ * by batch fills the heap before building it in linear time.
+ * The array of a bounded heap is allocated once for 'k' elements.
+ * Bounded heaps cannot be merged, and their keys should not be updated.
+ *
+ * The first 'k' elements can be read without modifying the heap,
+ * using 'peek_k'. Subtrees are walked as long as they can hold one
+ * of the 'k' first elements seen so far, kept in a heap within
+ * the output array itself: no memory is allocated.
+ *
+ * The shape of the heap can be inspected with 'bheap_stats'. Defining
+ * BHEAP_COUNTERS before including this file also maintains the number
+ * of burnt entries, readable at any time in 'counters'.
+ *
+ * The work done by the heap can be measured by defining
+ * 'BHEAP_INSTR(EV)' before including this file. It is then called
+ * with 'link' for each swap of containers, 'deref' for each container
+ * read while searching for a key to update, and 'alloc' when the
+ * array is reallocated. It does nothing otherwise.
+ *
+ * Defining BHEAP_USDT places USDT probes at the entry and return of
+ * insert, pop, update_key, merge and of each reallocation of the
+ * array, see 'PHEAP_USDT'. Their arguments are the heap, its number
+ * of entries, the running count of swaps made in the current thread
+ * and the capacity of the array.
  */
 
 struct bheap_node {
@@ -43,16 +95,66 @@ struct bheap_node {
 
 typedef int (*bheap_cmp)(struct bheap_node *a, struct bheap_node *b);
 
+#ifndef BHEAP_INSTR
+#define BHEAP_INSTR(EV) ((void) 0)
+#endif
+
+#ifdef BHEAP_USDT
+#include <sys/sdt.h>
+/* Swaps made by the binary heaps of the current thread. */
+static _Thread_local unsigned long long int bheap_usdt_swaps;
+#define BHEAP_USDT_SWAP() ((void) bheap_usdt_swaps++)
+#define BHEAP_PROBE(NAME, H) \
+    STAP_PROBE4(bheap, NAME, (H), (H)->n, bheap_usdt_swaps, (H)->capacity)
+#else
+#define BHEAP_USDT_SWAP() ((void) 0)
+#define BHEAP_PROBE(NAME, H) ((void) 0)
+#endif
+
+struct bheap_counters {
+    size_t n_invalid;
+};
+
 struct bheap {
     bheap_cmp cmp;
     struct bheap_node *entries;
     size_t capacity;
     size_t n;
+    /* Maximum number of elements, 0 if unbounded. */
+    size_t bound;
+#ifdef BHEAP_COUNTERS
+    struct bheap_counters counters;
+#endif
+};
+
+#ifdef BHEAP_COUNTERS
+#define BHEAP_COUNT(H, FIELD, D) ((H)->counters.FIELD += (D))
+#else
+#define BHEAP_COUNT(H, FIELD, D) ((void) 0)
+#endif
+
+/* Shape of a binary heap. */
+struct bheap_stats {
+    /* Entries in the array, burnt ones included. */
+    size_t n;
+    /* Burnt entries, only dropped once they reach the top. */
+    size_t n_invalid;
+    /* Allocated slots not in use. */
+    size_t slack;
+    /* Number of levels of the tree. */
+    size_t depth;
 };
 
 #define BHEAP_INITIALIZER(CMP) { \
     .cmp = CMP, .entries = NULL, \
     .capacity = 0, .n = 0, \
+    .bound = 0, \
+}
+
+#define BHEAP_BOUNDED_INITIALIZER(CMP, K) { \
+    .cmp = CMP, .entries = NULL, \
+    .capacity = 0, .n = 0, \
+    .bound = K, \
 }
 
 /* Binary heap interface. */
@@ -63,16 +165,134 @@ static inline void *bheap_peek(struct bheap *h);
 static inline void *bheap_pop(struct bheap *h);
 static inline void bheap_insert(struct bheap *h, struct bheap_node n);
 static inline void bheap_update_key(struct bheap *h, struct bheap_node new_key);
+static inline void bheap_merge(struct bheap *dst, struct bheap *src);
+/* Initialize a heap keeping at most 'k' elements, 'k' > 0. */
+static inline void bheap_init_bounded(struct bheap *h, bheap_cmp cmp, size_t k);
+/* Returns true if 'n' was kept. Inserting into a bounded heap
+ * is the same as offering, without the result. */
+static inline bool bheap_offer(struct bheap *h, struct bheap_node n);
+/* Offer 'count' containers, returns the number kept. */
+static inline size_t bheap_offer_batch(struct bheap *h,
+                                       struct bheap_node *nodes, size_t count);
+/* Copy the first 'k' containers of the heap in order into 'out',
+ * without modifying it. Returns the number of containers written. */
+static inline size_t bheap_peek_k(struct bheap *h, size_t k,
+                                  struct bheap_node out[]);
+/* Write the shape of the heap into 's', reading the whole array once. */
+static inline void bheap_stats(struct bheap *h, struct bheap_stats *s);
 
 /* Utility functions, used to implement
  * the above operations. Do not call directly. */
 
+#ifdef BHEAP_PAGE_SHIFT
+
+#define BHEAP_PAGE_SIZE ((size_t) 1 << BHEAP_PAGE_SHIFT)
+#define BHEAP_PAGE_MASK (BHEAP_PAGE_SIZE - 1)
+#define BHEAP_ROOT ((size_t) 1)
+
+/* Returns the position in the array of the k-th container. */
+static inline size_t
+bheap_index(size_t k)
+{
+    return ((k / (BHEAP_PAGE_SIZE - 1)) << BHEAP_PAGE_SHIFT) +
+           (k % (BHEAP_PAGE_SIZE - 1)) + 1;
+}
+
+/* Returns the position of the container following 'i'. */
+static inline size_t
+bheap_next(size_t i)
+{
+    i += 1;
+    return i + ((i & BHEAP_PAGE_MASK) == 0);
+}
+
+static inline size_t
+bheap_parent(size_t i)
+{
+    size_t o = i & BHEAP_PAGE_MASK;
+    size_t q;
+
+    if (o > 1) {
+        return (i - o) + (o >> 1);
+    }
+
+    /* Root of a page: its parent is a leaf of the parent page.
+     * Pages 'p * 2^SHIFT + 1 + j' are children of page 'p', the
+     * leaf 'l' of a page having children pages '2l' and '2l + 1'. */
+    q = (i >> BHEAP_PAGE_SHIFT) - 1;
+    return ((q >> BHEAP_PAGE_SHIFT) << BHEAP_PAGE_SHIFT) +
+           BHEAP_PAGE_SIZE / 2 + ((q & BHEAP_PAGE_MASK) >> 1);
+}
+
+static inline size_t
+bheap_left(size_t i)
+{
+    size_t o = i & BHEAP_PAGE_MASK;
+    size_t page;
+
+    if (o < BHEAP_PAGE_SIZE / 2) {
+        return (i - o) + (o << 1);
+    }
+
+    /* Leaf of a page: its children are roots of children pages. */
+    page = (i - o) + 1 + 2 * (o - BHEAP_PAGE_SIZE / 2);
+    return (page << BHEAP_PAGE_SHIFT) + 1;
+}
+
+static inline size_t
+bheap_right(size_t i, size_t left)
+{
+    if ((i & BHEAP_PAGE_MASK) < BHEAP_PAGE_SIZE / 2) {
+        return left + 1;
+    }
+    return left + BHEAP_PAGE_SIZE;
+}
+
+#else /* BHEAP_PAGE_SHIFT */
+
+#define BHEAP_ROOT ((size_t) 0)
+
+static inline size_t
+bheap_index(size_t k)
+{
+    return k;
+}
+
+static inline size_t
+bheap_next(size_t i)
+{
+    return i + 1;
+}
+
+static inline size_t
+bheap_parent(size_t i)
+{
+    return (i - 1) / 2;
+}
+
+static inline size_t
+bheap_left(size_t i)
+{
+    return 2 * i + 1;
+}
+
+static inline size_t
+bheap_right(size_t i, size_t left)
+{
+    (void) i;
+    return left + 1;
+}
+
+#endif /* BHEAP_PAGE_SHIFT */
+
 static inline void
 bheap_swap(struct bheap *h, size_t i, size_t j)
 {
     if (i != j) {
         struct bheap_node tmp = h->entries[i];
 
+        BHEAP_INSTR(link);
+        BHEAP_USDT_SWAP();
         h->entries[i] = h->entries[j];
         h->entries[j] = tmp;
     }
@@ -89,7 +309,7 @@ bheap_up(struct bheap *h, size_t i)
 {
     size_t parent;
 
-    while ((parent = (i - 1) / 2), i > 0 &&
+    while ((parent = bheap_parent(i)), i != BHEAP_ROOT &&
            bheap_cmp_entries(h, i, parent)) {
         bheap_swap(h, i, parent);
         i = parent;
@@ -99,10 +319,14 @@ bheap_up(struct bheap *h, size_t i)
 static inline void
 bheap_down(struct bheap *h, size_t i, size_t size)
 {
-    size_t next;
+    size_t end = bheap_index(size);
+    size_t next, right;
 
-    while ((next = (2 * i + 1)), next < size) {
-        next += (next + 1 < size && bheap_cmp_entries(h, next + 1, next));
+    while ((next = bheap_left(i)), next < end) {
+        right = bheap_right(i, next);
+        if (right < end && bheap_cmp_entries(h, right, next)) {
+            next = right;
+        }
         if (bheap_cmp_entries(h, i, next)) {
             break;
         }
@@ -117,15 +341,30 @@ bheap_realloc(struct bheap *h, size_t n)
     size_t c = h->capacity;
     void *p;
 
+    /* Bounded heaps are allocated once. */
+    if (h->bound != 0 && n < h->bound) {
+        n = h->bound;
+    }
+
+    /* Convert the number of containers to a number of slots. */
+    n = n ? bheap_index(n - 1) + 1 : 0;
     if (n > c) {
-        size_t delta = (1.75 * c) - c;
-        c += delta ? delta : 1;
+        while (n > c) {
+            size_t delta = (1.75 * c) - c;
+            c += delta ? delta : 1;
+        }
+        if (h->bound != 0) {
+            c = n;
+        }
+        BHEAP_INSTR(alloc);
+        BHEAP_PROBE(realloc_entry, h);
         p = realloc(h->entries, c * sizeof(h->entries[0]));
-        if (p == NULL) {
-            return false;
+        if (p != NULL) {
+            h->entries = p;
+            h->capacity = c;
         }
-        h->entries = p;
-        h->capacity = c;
+        BHEAP_PROBE(realloc_return, h);
+        return p != NULL;
     }
     return true;
 }
@@ -149,9 +388,12 @@ bheap_pop_(struct bheap *h)
         return;
     }
 
+    if (h->entries[BHEAP_ROOT].invalid) {
+        BHEAP_COUNT(h, n_invalid, -1);
+    }
     h->n -= 1;
-    bheap_swap(h, 0, h->n);
-    bheap_down(h, 0, h->n);
+    bheap_swap(h, BHEAP_ROOT, bheap_index(h->n));
+    bheap_down(h, BHEAP_ROOT, h->n);
 
     if (h->n == 0) {
         free(h->entries);
@@ -164,37 +406,43 @@ static inline void *
 bheap_peek(struct bheap *h)
 {
     while (!bheap_is_empty(h) &&
-           h->entries[0].invalid) {
+           h->entries[BHEAP_ROOT].invalid) {
         bheap_pop_(h);
     }
 
-    return bheap_is_empty(h) ? NULL : h->entries[0].data;
+    return bheap_is_empty(h) ? NULL : h->entries[BHEAP_ROOT].data;
 }
 
 static inline void *
 bheap_pop(struct bheap *h)
 {
-    void *top = bheap_peek(h);;
+    void *top;
 
-    if (top == NULL) {
-        return NULL;
+    BHEAP_PROBE(pop_entry, h);
+    top = bheap_peek(h);
+    if (top != NULL) {
+        bheap_pop_(h);
     }
-
-    bheap_pop_(h);
+    BHEAP_PROBE(pop_return, h);
     return top;
 }
 
 static inline void
 bheap_insert(struct bheap *h, struct bheap_node n)
 {
-    if (!bheap_realloc(h, h->n + 1)) {
+    if (h->bound != 0 && h->n >= h->bound) {
+        bheap_offer(h, n);
         return;
     }
 
-    n.invalid = false;
-    h->entries[h->n] = n;
-    bheap_up(h, h->n);
-    h->n += 1;
+    BHEAP_PROBE(insert_entry, h);
+    if (bheap_realloc(h, h->n + 1)) {
+        n.invalid = false;
+        h->entries[bheap_index(h->n)] = n;
+        bheap_up(h, bheap_index(h->n));
+        h->n += 1;
+    }
+    BHEAP_PROBE(insert_return, h);
 }
 
 static inline void
@@ -202,14 +450,347 @@ bheap_update_key(struct bheap *h, struct bheap_node new_key)
 {
     void *data = new_key.data;
 
-    for (size_t i = 0; i < h->n; i++) {
+    BHEAP_PROBE(update_key_entry, h);
+    for (size_t k = 0, i = BHEAP_ROOT; k < h->n; k++, i = bheap_next(i)) {
+        BHEAP_INSTR(deref);
         if (h->entries[i].data == data &&
             h->entries[i].invalid == false) {
             h->entries[i].invalid = true;
+            BHEAP_COUNT(h, n_invalid, 1);
             break;
         }
     }
     bheap_insert(h, new_key);
+    BHEAP_PROBE(update_key_return, h);
+}
+
+static inline size_t
+bheap_log2(size_t n)
+{
+    size_t l = 0;
+
+    while (n >>= 1) {
+        l++;
+    }
+    return l;
+}
+
+/* Remove burnt entries and rebuild the heap bottom-up. */
+static inline void
+bheap_heapify(struct bheap *h)
+{
+    size_t i, j, k, n = 0;
+
+    for (k = 0, i = j = BHEAP_ROOT; k < h->n; k++, i = bheap_next(i)) {
+        if (!h->entries[i].invalid) {
+            h->entries[j] = h->entries[i];
+            j = bheap_next(j);
+            n++;
+        }
+    }
+    BHEAP_COUNT(h, n_invalid, -(h->n - n));
+    h->n = n;
+
+    for (k = n; k-- > 0;) {
+        bheap_down(h, bheap_index(k), n);
+    }
+}
+
+/* Restore the heap invariant after entries were
+ * appended at the end of the array, starting with the n-th. */
+static inline void
+bheap_restore(struct bheap *h, size_t n)
+{
+    size_t m = h->n - n;
+    size_t i;
+
+    /* Sifting up costs at most log(n + m) swaps per new entry,
+     * rebuilding costs about two comparisons per entry. */
+    if (m * bheap_log2(n + m) > 2 * (n + m)) {
+        bheap_heapify(h);
+    } else {
+        for (i = n; i < n + m; i++) {
+            bheap_up(h, bheap_index(i));
+        }
+    }
+}
+
+static inline void
+bheap_merge(struct bheap *dst, struct bheap *src)
+{
+    bool swapped = false;
+    struct bheap tmp;
+    size_t n, m;
+
+    if (dst->cmp != src->cmp || src == dst || bheap_is_empty(src) ||
+        dst->bound != 0 || src->bound != 0) {
+        return;
+    }
+
+    BHEAP_PROBE(merge_entry, dst);
+    /* Append the smaller heap to the larger one. */
+    if (dst->n < src->n) {
+        tmp = *dst;
+        *dst = *src;
+        *src = tmp;
+        swapped = true;
+    }
+
+    n = dst->n;
+    m = src->n;
+    if (!bheap_realloc(dst, n + m)) {
+        /* Leave both heaps untouched. */
+        if (swapped) {
+            tmp = *dst;
+            *dst = *src;
+            *src = tmp;
+        }
+        BHEAP_PROBE(merge_return, dst);
+        return;
+    }
+#ifdef BHEAP_PAGE_SHIFT
+    for (size_t i = 0; i < m; i++) {
+        dst->entries[bheap_index(n + i)] = src->entries[bheap_index(i)];
+    }
+#else
+    if (m > 0) {
+        memcpy(&dst->entries[n], src->entries, m * sizeof src->entries[0]);
+    }
+#endif
+    dst->n = n + m;
+    BHEAP_COUNT(dst, n_invalid, src->counters.n_invalid);
+    bheap_restore(dst, n);
+
+    free(src->entries);
+    *src = (struct bheap) BHEAP_INITIALIZER(src->cmp);
+
+    if (bheap_is_empty(dst)) {
+        free(dst->entries);
+        dst->entries = NULL;
+        dst->capacity = 0;
+    }
+    BHEAP_PROBE(merge_return, dst);
+}
+
+static inline void
+bheap_init_bounded(struct bheap *h, bheap_cmp cmp, size_t k)
+{
+    *h = (struct bheap) BHEAP_BOUNDED_INITIALIZER(cmp, k);
+}
+
+/* Returns true if 'n' must replace the top of the full heap 'h'. */
+static inline bool
+bheap_accepts(struct bheap *h, struct bheap_node *top, struct bheap_node *n)
+{
+    return top->invalid || h->cmp(top, n) < 0;
+}
+
+static inline bool
+bheap_offer(struct bheap *h, struct bheap_node n)
+{
+    struct bheap_node *top;
+    size_t prev = h->n;
+
+    if (h->bound == 0 || h->n < h->bound) {
+        bheap_insert(h, n);
+        return h->n != prev;
+    }
+
+    top = &h->entries[BHEAP_ROOT];
+    if (!bheap_accepts(h, top, &n)) {
+        return false;
+    }
+
+    if (top->invalid) {
+        BHEAP_COUNT(h, n_invalid, -1);
+    }
+    n.invalid = false;
+    *top = n;
+    bheap_down(h, BHEAP_ROOT, h->n);
+    return true;
+}
+
+static inline size_t
+bheap_offer_batch(struct bheap *h, struct bheap_node *nodes, size_t count)
+{
+    struct bheap_node *top;
+    size_t fill = count;
+    size_t kept, n, i;
+
+    /* Fill the free room first, building the heap once. */
+    if (h->bound != 0) {
+        fill = h->n < h->bound ? h->bound - h->n : 0;
+        fill = fill < count ? fill : count;
+    }
+    if (fill > 0) {
+        n = h->n;
+        if (!bheap_realloc(h, n + fill)) {
+            return 0;
+        }
+        for (i = 0; i < fill; i++) {
+            h->entries[bheap_index(n + i)] = nodes[i];
+            h->entries[bheap_index(n + i)].invalid = false;
+        }
+        h->n = n + fill;
+        bheap_restore(h, n);
+    }
+
+    /* The remaining candidates are only compared to the top,
+     * the heap is touched only when one is accepted. */
+    kept = fill;
+    for (i = fill; i < count; i++) {
+        top = &h->entries[BHEAP_ROOT];
+        if (!bheap_accepts(h, top, &nodes[i])) {
+            continue;
+        }
+        if (top->invalid) {
+            BHEAP_COUNT(h, n_invalid, -1);
+        }
+        *top = nodes[i];
+        top->invalid = false;
+        bheap_down(h, BHEAP_ROOT, h->n);
+        kept++;
+    }
+
+    return kept;
+}
+
+/* Candidates of 'peek_k' are kept in a heap whose
+ * top is the last one in the order of 'h'. */
+static inline bool
+bheap_cand_after(struct bheap *h, struct bheap_node *a, struct bheap_node *b)
+{
+    return h->cmp(a, b) > 0;
+}
+
+static inline void
+bheap_cand_swap(struct bheap_node *a, struct bheap_node *b)
+{
+    struct bheap_node tmp = *a;
+
+    *a = *b;
+    *b = tmp;
+}
+
+static inline void
+bheap_cand_down(struct bheap *h, struct bheap_node out[], size_t i, size_t n)
+{
+    size_t next;
+
+    while ((next = (2 * i + 1)), next < n) {
+        next += (next + 1 < n &&
+                 bheap_cand_after(h, &out[next + 1], &out[next]));
+        if (!bheap_cand_after(h, &out[next], &out[i])) {
+            break;
+        }
+        bheap_cand_swap(&out[i], &out[next]);
+        i = next;
+    }
+}
+
+/* Consider entry 'i' for 'peek_k'. Returns false if
+ * its subtree cannot hold any of the first 'k' elements. */
+static inline bool
+bheap_peek_k_visit(struct bheap *h, size_t i, size_t k,
+                   struct bheap_node out[], size_t *n)
+{
+    struct bheap_node *e = &h->entries[i];
+    size_t j, parent;
+
+    if (*n == k) {
+        if (!bheap_cand_after(h, &out[0], e)) {
+            return false;
+        }
+        /* Burnt entries keep the heap order, look below. */
+        if (!e->invalid) {
+            out[0] = *e;
+            bheap_cand_down(h, out, 0, k);
+        }
+    } else if (!e->invalid) {
+        j = (*n)++;
+        out[j] = *e;
+        while ((parent = (j - 1) / 2), j > 0 &&
+               bheap_cand_after(h, &out[j], &out[parent])) {
+            bheap_cand_swap(&out[j], &out[parent]);
+            j = parent;
+        }
+    }
+    return true;
+}
+
+/* Move 'i' to the next entry in pre-order after its subtree.
+ * Returns false if there are none. */
+static inline bool
+bheap_skip_subtree(size_t *i, size_t end)
+{
+    size_t left, right, parent;
+
+    while (*i != BHEAP_ROOT) {
+        parent = bheap_parent(*i);
+        left = bheap_left(parent);
+        right = bheap_right(parent, left);
+        if (*i == left && right < end) {
+            *i = right;
+            return true;
+        }
+        *i = parent;
+    }
+    return false;
+}
+
+static inline size_t
+bheap_peek_k(struct bheap *h, size_t k, struct bheap_node out[])
+{
+    size_t end = bheap_index(h->n);
+    size_t i, left;
+    size_t n = 0;
+    bool more;
+
+    if (k == 0 || bheap_is_empty(h)) {
+        return 0;
+    }
+
+    /* Walk the tree in pre-order, without a stack. */
+    i = BHEAP_ROOT;
+    do {
+        left = bheap_left(i);
+        if (bheap_peek_k_visit(h, i, k, out, &n) && left < end) {
+            i = left;
+            more = true;
+        } else {
+            more = bheap_skip_subtree(&i, end);
+        }
+    } while (more);
+
+    /* Sort the candidates, the last one being at the top. */
+    for (i = n; i > 1; i--) {
+        bheap_cand_swap(&out[0], &out[i - 1]);
+        bheap_cand_down(h, out, 0, i - 1);
+    }
+    return n;
+}
+
+static inline void
+bheap_stats(struct bheap *h, struct bheap_stats *s)
+{
+    size_t i, k;
+
+    *s = (struct bheap_stats) { .n = h->n, };
+    if (bheap_is_empty(h)) {
+        s->slack = h->capacity;
+        return;
+    }
+
+    for (k = 0, i = BHEAP_ROOT; k < h->n; k++, i = bheap_next(i)) {
+        s->n_invalid += h->entries[i].invalid;
+    }
+
+    /* The last entry is on the deepest level. */
+    i = bheap_index(h->n - 1);
+    s->slack = h->capacity - (i + 1);
+    for (s->depth = 1; i != BHEAP_ROOT; s->depth++) {
+        i = bheap_parent(i);
+    }
 }
 
 #endif /* _BINARY_HEAP_H_ */
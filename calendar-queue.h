@@ -0,0 +1,497 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef _CALENDAR_QUEUE_H_
+#define _CALENDAR_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "mov-avg.h"
+
+/* Calendar queue.
+ *
+ * This is an intrusive implementation of the calendar queue described
+ * by R. Brown in 1988. Priorities are integers, typically timestamps,
+ * and the queue always returns the lowest one first.
+ *
+ * The priority line is cut into 'days' of 'width' units. Days are
+ * distributed round-robin into an array of buckets, each bucket
+ * being a sorted list of nodes. Dequeuing walks the buckets in order,
+ * a 'year' at a time, from the day of the last removed element. When
+ * priorities are clustered near this 'current day', insertion and
+ * removal both take expected O(1) time.
+ *
+ * The number of buckets follows the number of elements, doubling
+ * and halving as necessary. The day width is recomputed on each
+ * resize from the spacing between consecutive removed priorities,
+ * tracked with an exponential moving average. If the average number
+ * of steps per operation drifts too high, the calendar is resized
+ * in place to adapt the width to the current distribution.
+ *
+ * To use it, the elements inserted into the queue must contain a
+ * 'struct cqueue_node' field, that must not be modified outside of
+ * the cqueue API once inserted. The priority is given on insertion
+ * and on key update and is kept within the node.
+ *
+ * The bucket array is allocated during insertion and resized during
+ * insertion and removal. It is freed once all elements have been
+ * removed from the queue. If an allocation fails on resize, the
+ * queue keeps its current geometry.
+ *
+ * The work done by the queue can be measured by defining
+ * 'CQUEUE_INSTR(EV)' before including this file. It is then called
+ * with 'cmp' for each comparison of priorities, 'deref' for each node
+ * or bucket read while walking, 'link' when a node is inserted in
+ * a bucket and 'alloc' when the buckets are reallocated.
+ * It does nothing otherwise.
+ */
+
+#ifndef CQUEUE_INSTR
+#define CQUEUE_INSTR(EV) ((void) 0)
+#endif
+
+struct cqueue_node {
+    struct cqueue_node *prev;
+    struct cqueue_node *next;
+    long long int prio;
+};
+
+#define CQUEUE_NODE_INITIALIZER { \
+    .prev = NULL, .next = NULL, \
+    .prio = 0, \
+}
+
+struct cqueue {
+    struct cqueue_node **buckets;
+    size_t n_buckets;
+    size_t n;
+    long long int width;
+    /* Current position: bucket and day of the last removal. */
+    size_t cur;
+    long long int day;
+    /* Resizing heuristics. */
+    long long int last_prio;
+    bool has_last_prio;
+    size_t n_ops;
+    struct mov_avg_ema spacing;
+    struct mov_avg_ema cost;
+};
+
+/* Smoothing of the spacing and cost estimators,
+ * expressed as a number of past operations. */
+#define CQUEUE_EMA_N 32
+
+#define CQUEUE_INITIALIZER { \
+    .buckets = NULL, .n_buckets = 0, .n = 0, \
+    .width = 1, .cur = 0, .day = 0, \
+    .last_prio = 0, .has_last_prio = false, .n_ops = 0, \
+    .spacing = MOV_AVG_EMA_INITIALIZER(CQUEUE_EMA_N), \
+    .cost = MOV_AVG_EMA_INITIALIZER(CQUEUE_EMA_N), \
+}
+
+/* Number of buckets must be a power of two. */
+#define CQUEUE_MIN_BUCKETS 2
+
+/* Average number of list or bucket steps per operation
+ * above which the day width is recomputed. */
+#define CQUEUE_MAX_COST 8.0
+
+/* Shape of a calendar queue. */
+struct cqueue_stats {
+    size_t n;
+    size_t n_buckets;
+    long long int width;
+    /* Buckets holding no element. */
+    size_t n_empty;
+    /* Length of the longest bucket, walked on insertion. */
+    size_t max_bucket;
+    /* Average number of steps per operation,
+     * driving the adaptation of the width. */
+    double cost;
+};
+
+/* Calendar queue API. */
+
+/* Initialize a queue. Must be called first unless
+ * the static CQUEUE_INITIALIZER has been used. */
+static inline void cqueue_init(struct cqueue *h);
+
+/* Returns 'true' if the queue is empty. */
+static inline bool cqueue_is_empty(struct cqueue *h);
+
+/* Returns the element with the lowest priority. */
+static inline struct cqueue_node *cqueue_peek(struct cqueue *h);
+
+/* Removes the element with the lowest priority. */
+static inline struct cqueue_node *cqueue_pop(struct cqueue *h);
+
+/* Insert an element with priority 'prio'. */
+static inline void cqueue_insert(struct cqueue *h, struct cqueue_node *n,
+                                 long long int prio);
+
+/* Remove any element from the queue.
+ * Make sure that the element is part of the queue first. */
+static inline void cqueue_remove(struct cqueue *h, struct cqueue_node *n);
+
+/* Set the priority of an element already within the queue to 'prio'.
+ * The update can be done in either direction. */
+static inline void cqueue_update_key(struct cqueue *h, struct cqueue_node *n,
+                                     long long int prio);
+
+/* Write the shape of the queue into 's', walking all buckets once.
+ * Long buckets or many empty ones mean that the day width
+ * does not fit the current distribution of priorities. */
+static inline void cqueue_stats(struct cqueue *h, struct cqueue_stats *s);
+
+/* Utility functions, used to implement
+ * the above operations. Do not call directly. */
+
+static inline long long int
+cqueue_day(struct cqueue *h, long long int prio)
+{
+    long long int day = prio / h->width;
+
+    /* Round toward negative infinity. */
+    if (prio < 0 && day * h->width != prio) {
+        day--;
+    }
+    return day;
+}
+
+static inline size_t
+cqueue_bucket(struct cqueue *h, long long int day)
+{
+    /* Unsigned conversion is modular, which
+     * handles negative days as well. */
+    return (size_t) day & (h->n_buckets - 1);
+}
+
+static inline void
+cqueue_set_cursor(struct cqueue *h, long long int prio)
+{
+    h->day = cqueue_day(h, prio);
+    h->cur = cqueue_bucket(h, h->day);
+}
+
+/* Insert 'n' in the sorted list 'head', after any equal priority.
+ * Returns the number of nodes walked. */
+static inline size_t
+cqueue_list_insert(struct cqueue_node **head, struct cqueue_node *n)
+{
+    struct cqueue_node *prev = NULL;
+    struct cqueue_node *it = *head;
+    size_t steps = 0;
+
+    while (it != NULL && (CQUEUE_INSTR(cmp), it->prio <= n->prio)) {
+        CQUEUE_INSTR(deref);
+        prev = it;
+        it = it->next;
+        steps++;
+    }
+
+    CQUEUE_INSTR(link);
+    n->prev = prev;
+    n->next = it;
+    if (it != NULL) {
+        it->prev = n;
+    }
+    if (prev != NULL) {
+        prev->next = n;
+    } else {
+        *head = n;
+    }
+
+    return steps;
+}
+
+static inline void
+cqueue_list_unlink(struct cqueue_node **head, struct cqueue_node *n)
+{
+    if (n->prev != NULL) {
+        n->prev->next = n->next;
+    } else {
+        *head = n->next;
+    }
+    if (n->next != NULL) {
+        n->next->prev = n->prev;
+    }
+    n->next = n->prev = NULL;
+}
+
+static inline void
+cqueue_account(struct cqueue *h, size_t steps)
+{
+    mov_avg_ema_update(&h->cost, steps);
+    h->n_ops++;
+}
+
+/* Compute the day width for the current elements,
+ * of which 'min' and 'max' are the extreme priorities. */
+static inline long long int
+cqueue_width(struct cqueue *h, long long int min, long long int max)
+{
+    const double max_width = (double) (1ULL << 62);
+    double spacing;
+    double width;
+
+    if (h->spacing.initialized) {
+        spacing = mov_avg_ema(&h->spacing);
+    } else if (h->n > 1) {
+        spacing = ((double) max - (double) min) / (double) (h->n - 1);
+    } else {
+        return h->width;
+    }
+
+    /* About three elements per day near the front of the queue. */
+    width = 3.0 * spacing;
+    if (width < 1.0) {
+        return 1;
+    } else if (width > max_width) {
+        return (long long int) max_width;
+    }
+    return (long long int) width;
+}
+
+static inline bool
+cqueue_resize(struct cqueue *h, size_t n_buckets)
+{
+    struct cqueue_node *list = NULL;
+    struct cqueue_node **buckets;
+    struct cqueue_node *n;
+    long long int min = 0;
+    long long int max = 0;
+    size_t i;
+
+    CQUEUE_INSTR(alloc);
+    buckets = calloc(n_buckets, sizeof buckets[0]);
+    if (buckets == NULL) {
+        return false;
+    }
+
+    /* Chain all nodes in a single list, using 'next'. */
+    for (i = 0; i < h->n_buckets; i++) {
+        while ((n = h->buckets[i]) != NULL) {
+            h->buckets[i] = n->next;
+            if (list == NULL || n->prio < min) {
+                min = n->prio;
+            }
+            if (list == NULL || n->prio > max) {
+                max = n->prio;
+            }
+            n->next = list;
+            list = n;
+        }
+    }
+    free(h->buckets);
+
+    h->buckets = buckets;
+    h->n_buckets = n_buckets;
+    h->width = cqueue_width(h, min, max);
+
+    while ((n = list) != NULL) {
+        list = n->next;
+        cqueue_list_insert(&h->buckets[cqueue_bucket(h, cqueue_day(h, n->prio))],
+                           n);
+    }
+
+    cqueue_set_cursor(h, min);
+    mov_avg_ema_init(&h->cost, CQUEUE_EMA_N);
+    h->n_ops = 0;
+
+    return true;
+}
+
+static inline void
+cqueue_adapt(struct cqueue *h)
+{
+    if (h->n > 2 * h->n_buckets) {
+        cqueue_resize(h, 2 * h->n_buckets);
+    } else if (h->n < h->n_buckets / 2 &&
+               h->n_buckets > CQUEUE_MIN_BUCKETS) {
+        cqueue_resize(h, h->n_buckets / 2);
+    } else if (h->n_ops > h->n_buckets &&
+               mov_avg_ema(&h->cost) > CQUEUE_MAX_COST) {
+        cqueue_resize(h, h->n_buckets);
+    }
+}
+
+static inline void
+cqueue_remove_(struct cqueue *h, struct cqueue_node *n)
+{
+    size_t b = cqueue_bucket(h, cqueue_day(h, n->prio));
+
+    cqueue_list_unlink(&h->buckets[b], n);
+    h->n -= 1;
+}
+
+static inline void
+cqueue_release(struct cqueue *h)
+{
+    free(h->buckets);
+    h->buckets = NULL;
+    h->n_buckets = 0;
+}
+
+/* Calendar queue implementation. */
+
+static inline void
+cqueue_init(struct cqueue *h)
+{
+    *h = (struct cqueue) CQUEUE_INITIALIZER;
+}
+
+static inline bool
+cqueue_is_empty(struct cqueue *h)
+{
+    return h->n == 0;
+}
+
+static inline struct cqueue_node *
+cqueue_peek(struct cqueue *h)
+{
+    struct cqueue_node *min = NULL;
+    struct cqueue_node *first;
+    size_t i;
+
+    if (cqueue_is_empty(h)) {
+        return NULL;
+    }
+
+    /* Walk at most one year from the current day. All elements
+     * are at or after the current day, so the first one found
+     * within its own day is the minimum. */
+    for (i = 0; i < h->n_buckets; i++) {
+        CQUEUE_INSTR(deref);
+        first = h->buckets[h->cur];
+        if (first != NULL && cqueue_day(h, first->prio) <= h->day) {
+            cqueue_account(h, i);
+            return first;
+        }
+        h->cur = (h->cur + 1) & (h->n_buckets - 1);
+        h->day++;
+    }
+
+    /* The year was empty: search directly for the minimum. */
+    for (i = 0; i < h->n_buckets; i++) {
+        CQUEUE_INSTR(deref);
+        first = h->buckets[i];
+        if (first != NULL && (min == NULL || first->prio < min->prio)) {
+            min = first;
+        }
+    }
+    cqueue_set_cursor(h, min->prio);
+    cqueue_account(h, 2 * h->n_buckets);
+
+    return min;
+}
+
+static inline struct cqueue_node *
+cqueue_pop(struct cqueue *h)
+{
+    struct cqueue_node *top = cqueue_peek(h);
+
+    if (top == NULL) {
+        return NULL;
+    }
+
+    cqueue_list_unlink(&h->buckets[h->cur], top);
+    h->n -= 1;
+
+    if (h->has_last_prio && top->prio >= h->last_prio) {
+        double spacing = (double) top->prio - (double) h->last_prio;
+        double limit = 4.0 * mov_avg_ema(&h->spacing);
+
+        /* Clip outliers, while still allowing
+         * the average to follow a changing distribution.
+         * The limit never goes below the minimum width, otherwise
+         * a run of equal priorities would pin the average at 0. */
+        if (limit < 1.0) {
+            limit = 1.0;
+        }
+        if (h->spacing.initialized && spacing > limit) {
+            spacing = limit;
+        }
+        mov_avg_ema_update(&h->spacing, spacing);
+    }
+    h->last_prio = top->prio;
+    h->has_last_prio = true;
+
+    if (cqueue_is_empty(h)) {
+        cqueue_release(h);
+    } else {
+        cqueue_adapt(h);
+    }
+
+    return top;
+}
+
+static inline void
+cqueue_insert(struct cqueue *h, struct cqueue_node *n, long long int prio)
+{
+    size_t steps;
+
+    if (h->n_buckets == 0 &&
+        !cqueue_resize(h, CQUEUE_MIN_BUCKETS)) {
+        return;
+    }
+
+    n->prio = prio;
+    if (cqueue_is_empty(h) || cqueue_day(h, prio) < h->day) {
+        cqueue_set_cursor(h, prio);
+    }
+
+    steps = cqueue_list_insert(&h->buckets[cqueue_bucket(h, cqueue_day(h, prio))],
+                               n);
+    h->n += 1;
+
+    cqueue_account(h, steps);
+    cqueue_adapt(h);
+}
+
+static inline void
+cqueue_remove(struct cqueue *h, struct cqueue_node *n)
+{
+    cqueue_remove_(h, n);
+    if (cqueue_is_empty(h)) {
+        cqueue_release(h);
+    } else {
+        cqueue_adapt(h);
+    }
+}
+
+static inline void
+cqueue_update_key(struct cqueue *h, struct cqueue_node *n, long long int prio)
+{
+    cqueue_remove_(h, n);
+    cqueue_insert(h, n, prio);
+}
+
+static inline void
+cqueue_stats(struct cqueue *h, struct cqueue_stats *s)
+{
+    struct cqueue_node *n;
+    size_t i, len;
+
+    *s = (struct cqueue_stats) {
+        .n = h->n,
+        .n_buckets = h->n_buckets,
+        .width = h->width,
+        .cost = mov_avg_ema(&h->cost),
+    };
+
+    for (i = 0; i < h->n_buckets; i++) {
+        len = 0;
+        for (n = h->buckets[i]; n != NULL; n = n->next) {
+            len++;
+        }
+        s->n_empty += (len == 0);
+        if (s->max_bucket < len) {
+            s->max_bucket = len;
+        }
+    }
+}
+
+#endif /* _CALENDAR_QUEUE_H_ */
@@ -0,0 +1,19 @@
+# This version of config.mk was generated by:
+# ./configure
+# Any changes made here will be lost if configure is re-used
+
+AR = $(CROSS_COMPILE)ar
+RANLIB = $(CROSS_COMPILE)ranlib
+PREFIX = 
+BINDIR = 
+LIBDIR = 
+INCLUDEDIR = 
+CC = gcc
+CFLAGS = 
+CFLAGS_AUTO = -g3 -fno-omit-frame-pointer -mno-omit-leaf-frame-pointer -O2 -Werror=implicit-function-declaration -Werror=implicit-int -Werror=pointer-sign -Werror=pointer-arith -Werror -Wall -Wextra -Wno-parentheses -Wno-uninitialized -Wno-missing-braces -Wno-unused-value -Wno-unused-but-set-variable -Wno-unknown-pragmas -Wno-pointer-to-int-cast
+CFLAGS_SAN = -fsanitize=address,leak,undefined
+LDFLAGS = 
+LDFLAGS_AUTO = 
+CROSS_COMPILE = 
+
+CONFIGURED = yes
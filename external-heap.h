@@ -0,0 +1,569 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef _EXTERNAL_HEAP_H_
+#define _EXTERNAL_HEAP_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "binary-heap.h"
+#include "tournament-tree.h"
+
+/* External-memory heap.
+ *
+ * This heap can hold more elements than its memory budget,
+ * by spilling sorted runs to files in a scratch directory.
+ *
+ * Elements are small containers: a priority and a data pointer,
+ * written as is to the runs. For the heap to exceed the memory,
+ * the data should thus be a handle, such as an index or an offset,
+ * rather than a pointer to memory holding each element.
+ * Priorities are returned lowest first.
+ *
+ * New elements go to an insertion buffer, a bounded binary heap.
+ * When it is full, it is emptied in sorted order into a new run file,
+ * written one block at a time. Runs are read back one block at a time
+ * and merged lazily by a tournament tree, whose top is compared
+ * with the top of the insertion buffer on each removal.
+ *
+ * The memory budget is split between one read buffer per run,
+ * a write buffer and the insertion buffer. Read buffers take
+ * a quarter of the budget, setting the maximum number of runs.
+ *
+ * Runs have a level: runs written from the insertion buffer are at
+ * level 0. When a new run is needed and all are in use, the runs of
+ * the lowest levels, at least two, are merged into a single run one
+ * level above. Each element is thus written again a logarithmic number
+ * of times, rather than on each merge as when merging all runs.
+ *
+ * Run files are unlinked as soon as they are created, and closed
+ * once consumed. Insertion returns false if an element could not
+ * be stored, due to an I/O or allocation error. If reading a run fails,
+ * its remaining elements are lost and the error is kept in 'error'.
+ *
+ * Data is never interpreted, and may be NULL or 0: peek and pop
+ * return false when the heap is empty.
+ *
+ * Key updates are not supported. The heap must be released by
+ * 'destroy' once done, even if empty.
+ */
+
+struct eheap_node {
+    void *data;
+    long long int priority;
+};
+
+struct eheap_run {
+    int fd;
+    /* Elements in the file, not yet read. */
+    size_t n_left;
+    off_t offset;
+    /* Current block. */
+    struct eheap_node *buf;
+    size_t pos;
+    size_t len;
+    unsigned int level;
+    /* The head held by the merge tree was given to a merge of runs. */
+    bool head_moved;
+};
+
+struct eheap {
+    char *path;
+    /* Elements per block. */
+    size_t block;
+    struct bheap ins;
+    struct eheap_run *runs;
+    size_t max_runs;
+    struct ttree merge;
+    /* Runs merged together when all are in use. */
+    size_t *group;
+    struct eheap_node *wbuf;
+    size_t n;
+    /* Last I/O error, 0 if none. */
+    int error;
+};
+
+/* External-memory heap interface. */
+
+/* Initialize a heap using at most 'budget' bytes of memory, doing I/O
+ * by blocks of 'block_size' bytes and writing runs in 'dir'.
+ * Returns false if the budget is too small or memory is lacking. */
+static inline bool eheap_init(struct eheap *h, const char *dir,
+                              size_t budget, size_t block_size);
+static inline bool eheap_is_empty(struct eheap *h);
+/* Write the data of the lowest element in 'data'.
+ * Returns false if the heap is empty. */
+static inline bool eheap_peek(struct eheap *h, void **data);
+/* Remove the lowest element, writing its data in 'data'.
+ * Returns false if the heap is empty. */
+static inline bool eheap_pop(struct eheap *h, void **data);
+static inline bool eheap_insert(struct eheap *h, struct eheap_node n);
+/* Close all runs and release the memory. */
+static inline void eheap_destroy(struct eheap *h);
+
+/* Utility functions, used to implement
+ * the above operations. Do not call directly. */
+
+static inline int
+eheap_bheap_cmp(struct bheap_node *a, struct bheap_node *b)
+{
+    return (a->priority.lli > b->priority.lli) -
+           (a->priority.lli < b->priority.lli);
+}
+
+static inline int
+eheap_ttree_cmp(struct ttree_node *a, struct ttree_node *b)
+{
+    return (a->priority.lli > b->priority.lli) -
+           (a->priority.lli < b->priority.lli);
+}
+
+static inline void
+eheap_run_close(struct eheap_run *r)
+{
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    r->fd = -1;
+    r->n_left = 0;
+    r->offset = 0;
+    r->pos = r->len = 0;
+}
+
+/* Read the next block of run 'r'. */
+static inline bool
+eheap_run_fill(struct eheap *h, struct eheap_run *r)
+{
+    size_t n = r->n_left < h->block ? r->n_left : h->block;
+    size_t size = n * sizeof r->buf[0];
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < size) {
+        ret = pread(r->fd, (char *) r->buf + done, size - done,
+                    r->offset + done);
+        if (ret <= 0) {
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            h->error = ret < 0 ? errno : EIO;
+            return false;
+        }
+        done += ret;
+    }
+
+    r->offset += size;
+    r->n_left -= n;
+    r->pos = 0;
+    r->len = n;
+    return n > 0;
+}
+
+static inline bool
+eheap_cursor(void *aux, size_t run, struct ttree_node *n)
+{
+    struct eheap *h = aux;
+    struct eheap_run *r = &h->runs[run];
+
+    if (r->fd < 0) {
+        return false;
+    }
+    if (r->pos == r->len && (r->n_left == 0 || !eheap_run_fill(h, r))) {
+        eheap_run_close(r);
+        return false;
+    }
+
+    n->data = r->buf[r->pos].data;
+    n->priority.lli = r->buf[r->pos].priority;
+    r->pos++;
+    return true;
+}
+
+static inline bool
+eheap_write(struct eheap *h, int fd, size_t n)
+{
+    size_t size = n * sizeof h->wbuf[0];
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < size) {
+        ret = write(fd, (char *) h->wbuf + done, size - done);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            h->error = errno;
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+/* Create an unlinked scratch file. */
+static inline int
+eheap_create(struct eheap *h)
+{
+    char *path = strdup(h->path);
+    int fd;
+
+    if (path == NULL) {
+        return -1;
+    }
+    fd = mkstemp(path);
+    if (fd < 0) {
+        h->error = errno;
+    } else {
+        unlink(path);
+    }
+    free(path);
+    return fd;
+}
+
+/* Returns the top of the runs merged by 't',
+ * or NULL if they are all consumed. */
+static inline struct ttree_node *
+eheap_tree_top(struct ttree *t)
+{
+    return ttree_is_empty(t) ? NULL : &t->leaves[t->losers[0]].node;
+}
+
+static inline struct ttree_node *
+eheap_merge_top(struct eheap *h)
+{
+    return eheap_tree_top(&h->merge);
+}
+
+/* Returns the top of the insertion buffer, or NULL if it is empty.
+ * Its data cannot tell, being possibly NULL. */
+static inline struct bheap_node *
+eheap_ins_top(struct eheap *h)
+{
+    return h->ins.n == 0 ? NULL : &h->ins.entries[BHEAP_ROOT];
+}
+
+static inline int
+eheap_free_run(struct eheap *h)
+{
+    size_t i;
+
+    for (i = 0; i < h->max_runs; i++) {
+        if (h->runs[i].fd < 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Write all elements of either the runs merged by 'src', or the
+ * insertion buffer if NULL, to the new run file 'fd' in slot 'i'.
+ * Returns false if it could not be completed, closing 'fd'.
+ * When merging runs, the slot is free once they are all consumed. */
+static inline bool
+eheap_spill(struct eheap *h, int fd, size_t i, struct ttree *src,
+            unsigned int level)
+{
+    struct eheap_run *r = &h->runs[i];
+    size_t count = 0;
+    bool ok = true;
+    size_t n = 0;
+
+    for (;;) {
+        struct eheap_node *w = &h->wbuf[n];
+
+        if (src != NULL) {
+            struct ttree_node *top = eheap_tree_top(src);
+
+            if (top == NULL) {
+                break;
+            }
+            w->priority = top->priority.lli;
+            w->data = ttree_next(src);
+        } else {
+            struct bheap_node *top = eheap_ins_top(h);
+
+            if (top == NULL) {
+                break;
+            }
+            w->priority = top->priority.lli;
+            w->data = bheap_pop(&h->ins);
+        }
+        count++;
+        if (++n == h->block) {
+            ok = eheap_write(h, fd, n);
+            if (!ok) {
+                break;
+            }
+            n = 0;
+        }
+    }
+
+    if (!ok || (n > 0 && !eheap_write(h, fd, n))) {
+        /* Elements already taken from their source are lost. */
+        h->n -= count;
+        close(fd);
+        return false;
+    }
+
+    r->fd = fd;
+    r->n_left = count;
+    r->offset = 0;
+    r->pos = r->len = 0;
+    r->level = level;
+    ttree_replace_run(&h->merge, i);
+    return true;
+}
+
+/* Cursor of the runs merged together, listed in 'group'.
+ * Their head, already read by the merge tree, comes first. */
+static inline bool
+eheap_group_cursor(void *aux, size_t run, struct ttree_node *n)
+{
+    struct eheap *h = aux;
+    size_t i = h->group[run];
+    struct eheap_run *r = &h->runs[i];
+    struct ttree_leaf *l = &h->merge.leaves[i];
+
+    if (!r->head_moved) {
+        r->head_moved = true;
+        if (!l->exhausted) {
+            *n = l->node;
+            return true;
+        }
+    }
+    return eheap_cursor(h, i, n);
+}
+
+/* Merge the runs of the two lowest levels into a single run,
+ * one level above, freeing at least one slot. */
+static inline bool
+eheap_merge_runs(struct eheap *h)
+{
+    unsigned int min[2] = { UINT_MAX, UINT_MAX };
+    struct ttree t;
+    size_t k = 0;
+    bool ok;
+    size_t i;
+    int fd;
+
+    /* Two lowest levels, possibly equal. */
+    for (i = 0; i < h->max_runs; i++) {
+        unsigned int level = h->runs[i].level;
+
+        if (h->runs[i].fd < 0) {
+            continue;
+        }
+        if (level < min[0]) {
+            min[1] = min[0];
+            min[0] = level;
+        } else if (level < min[1]) {
+            min[1] = level;
+        }
+    }
+    if (min[1] == UINT_MAX) {
+        return false;
+    }
+
+    for (i = 0; i < h->max_runs; i++) {
+        if (h->runs[i].fd >= 0 && h->runs[i].level <= min[1]) {
+            h->runs[i].head_moved = false;
+            h->group[k++] = i;
+        }
+    }
+
+    fd = eheap_create(h);
+    if (fd < 0) {
+        return false;
+    }
+    if (!ttree_init(&t, eheap_ttree_cmp, k, eheap_group_cursor, h)) {
+        close(fd);
+        return false;
+    }
+
+    ok = eheap_spill(h, fd, h->group[0], &t, min[1] + 1);
+    if (!ok) {
+        /* Heads held by the group tree are lost. */
+        for (i = 0; i < k; i++) {
+            if (!t.leaves[i].exhausted) {
+                h->n -= 1;
+            }
+        }
+    }
+    ttree_finish(&t);
+
+    /* The first run was replaced by the spill if it succeeded,
+     * read the heads of the others again, most being consumed. */
+    for (i = ok ? 1 : 0; i < k; i++) {
+        ttree_replace_run(&h->merge, h->group[i]);
+    }
+    return ok;
+}
+
+/* Empty the insertion buffer into a new run. */
+static inline bool
+eheap_flush(struct eheap *h)
+{
+    int i = eheap_free_run(h);
+    int fd;
+
+    if (i < 0) {
+        if (!eheap_merge_runs(h)) {
+            return false;
+        }
+        i = eheap_free_run(h);
+    }
+
+    fd = eheap_create(h);
+    if (fd < 0) {
+        return false;
+    }
+    return eheap_spill(h, fd, i, NULL, 0);
+}
+
+static inline bool
+eheap_init(struct eheap *h, const char *dir, size_t budget, size_t block_size)
+{
+    static const char name[] = "/eheap-XXXXXX";
+    size_t block = block_size / sizeof(struct eheap_node);
+    size_t n_ins;
+    bool ok;
+    size_t i;
+
+    memset(h, 0, sizeof *h);
+    h->block = block;
+    h->max_runs = budget / 4 / (block_size ? block_size : 1);
+    if (block == 0 || h->max_runs < 2) {
+        return false;
+    }
+
+    /* Read buffers for all runs, and a write buffer. */
+    budget -= (h->max_runs + 1) * block * sizeof(struct eheap_node);
+    n_ins = budget / sizeof(struct bheap_node);
+    if (n_ins < 2) {
+        return false;
+    }
+    bheap_init_bounded(&h->ins, eheap_bheap_cmp, n_ins);
+
+    h->path = malloc(strlen(dir) + sizeof name);
+    h->runs = calloc(h->max_runs, sizeof h->runs[0]);
+    h->group = malloc(h->max_runs * sizeof h->group[0]);
+    h->wbuf = malloc(block * sizeof h->wbuf[0]);
+    ok = h->path != NULL && h->runs != NULL && h->group != NULL &&
+         h->wbuf != NULL;
+
+    for (i = 0; h->runs != NULL && i < h->max_runs; i++) {
+        h->runs[i].fd = -1;
+    }
+    for (i = 0; ok && i < h->max_runs; i++) {
+        h->runs[i].buf = malloc(block * sizeof h->runs[i].buf[0]);
+        ok = h->runs[i].buf != NULL;
+    }
+
+    if (!ok || !ttree_init(&h->merge, eheap_ttree_cmp, h->max_runs,
+                           eheap_cursor, h)) {
+        eheap_destroy(h);
+        return false;
+    }
+
+    strcpy(h->path, dir);
+    strcat(h->path, name);
+    return true;
+}
+
+static inline bool
+eheap_is_empty(struct eheap *h)
+{
+    return h->n == 0;
+}
+
+static inline bool
+eheap_peek(struct eheap *h, void **data)
+{
+    struct ttree_node *r = eheap_merge_top(h);
+    struct bheap_node *b = eheap_ins_top(h);
+
+    if (r != NULL && (b == NULL || r->priority.lli <= b->priority.lli)) {
+        *data = r->data;
+    } else if (b != NULL) {
+        *data = b->data;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static inline bool
+eheap_pop(struct eheap *h, void **data)
+{
+    struct ttree_node *r = eheap_merge_top(h);
+    struct bheap_node *b = eheap_ins_top(h);
+
+    if (r != NULL && (b == NULL || r->priority.lli <= b->priority.lli)) {
+        *data = ttree_next(&h->merge);
+    } else if (b != NULL) {
+        *data = bheap_pop(&h->ins);
+    } else {
+        /* Elements lost on a read error. */
+        h->n = 0;
+        return false;
+    }
+
+    h->n -= 1;
+    return true;
+}
+
+static inline bool
+eheap_insert(struct eheap *h, struct eheap_node n)
+{
+    struct bheap_node b = {
+        .data = n.data,
+        .priority.lli = n.priority,
+    };
+
+    if (h->ins.n == h->ins.bound && !eheap_flush(h)) {
+        return false;
+    }
+
+    if (!bheap_offer(&h->ins, b)) {
+        return false;
+    }
+    h->n += 1;
+    return true;
+}
+
+static inline void
+eheap_destroy(struct eheap *h)
+{
+    size_t i;
+
+    ttree_finish(&h->merge);
+    if (h->runs != NULL) {
+        for (i = 0; i < h->max_runs; i++) {
+            eheap_run_close(&h->runs[i]);
+            free(h->runs[i].buf);
+        }
+    }
+    while (h->ins.n > 0) {
+        bheap_pop(&h->ins);
+    }
+    free(h->runs);
+    free(h->group);
+    free(h->wbuf);
+    free(h->path);
+    h->runs = NULL;
+    h->group = NULL;
+    h->wbuf = NULL;
+    h->path = NULL;
+    h->n = 0;
+}
+
+#endif /* _EXTERNAL_HEAP_H_ */
@@ -20,6 +20,20 @@
  * and as a study.
  *
  * No allocation is made during any heap operations.
+ *
+ * The shape of the heap can be inspected with 'fheap_stats'. Defining
+ * FHEAP_COUNTERS before including this file also maintains the number
+ * of nodes and the length of the root list, readable in 'counters'.
+ *
+ * The work done by the heap can be measured by defining
+ * 'FHEAP_INSTR(EV)' before including this file, see 'PHEAP_INSTR'.
+ * It is called with 'link' when a node is linked in a list,
+ * and 'deref' for each node reached while walking lists.
+ *
+ * Defining FHEAP_USDT places USDT probes at the entry and return of
+ * insert, pop, merge, update_key and consolidate, see 'PHEAP_USDT'.
+ * Their arguments are the heap, its number of nodes, the running count
+ * of links made in the current thread and the length of the root list.
  */
 
 struct fheap_node {
@@ -42,9 +56,61 @@ struct fheap_node {
 
 typedef int (*fheap_cmp)(struct fheap_node *a, struct fheap_node *b);
 
+#ifndef FHEAP_INSTR
+#define FHEAP_INSTR(EV) ((void) 0)
+#endif
+
+#ifdef FHEAP_USDT
+#include <sys/sdt.h>
+#ifndef FHEAP_COUNTERS
+#define FHEAP_COUNTERS
+#endif
+/* Links made by the fibonacci heaps of the current thread. */
+static _Thread_local unsigned long long int fheap_usdt_links;
+#define FHEAP_USDT_LINK() ((void) fheap_usdt_links++)
+#define FHEAP_PROBE(NAME, H) \
+    STAP_PROBE4(fheap, NAME, (H), (H)->counters.n, fheap_usdt_links, \
+                (H)->counters.n_roots)
+#else
+#define FHEAP_USDT_LINK() ((void) 0)
+#define FHEAP_PROBE(NAME, H) ((void) 0)
+#endif
+
+struct fheap_counters {
+    size_t n;
+    size_t n_roots;
+};
+
 struct fheap {
     struct fheap_node *root;
     fheap_cmp cmp;
+#ifdef FHEAP_COUNTERS
+    struct fheap_counters counters;
+#endif
+};
+
+#ifdef FHEAP_COUNTERS
+#define FHEAP_COUNT(H, FIELD, D) ((H)->counters.FIELD += (D))
+#else
+#define FHEAP_COUNT(H, FIELD, D) ((void) 0)
+#endif
+
+/* Bound on the rank of any node, far above what
+ * the number of addressable nodes allows. */
+#define FHEAP_N_RANKS 64
+
+/* Shape of a fibonacci heap. */
+struct fheap_stats {
+    /* Number of nodes. */
+    size_t n;
+    /* Length of the root list, consolidated on the next removal. */
+    size_t n_roots;
+    /* Nodes that lost a child since they were linked. */
+    size_t n_marked;
+    /* Longest path from the root list, in number of links. */
+    size_t depth;
+    /* Number of nodes of each rank. */
+    size_t ranks[FHEAP_N_RANKS];
 };
 
 #define FHEAP_INITIALIZER(CMP) { \
@@ -60,6 +126,14 @@ static inline struct fheap_node *fheap_pop(struct fheap *h);
 static inline void fheap_insert(struct fheap *h, struct fheap_node *node);
 static inline void fheap_merge(struct fheap *dst, struct fheap *src);
 static inline void fheap_update_key(struct fheap *h, struct fheap_node *n);
+/* Write the first 'k' nodes of the heap in order into 'out',
+ * without modifying it. Returns the number of nodes written.
+ * No memory is allocated, see 'pheap_peek_k'. */
+static inline size_t fheap_peek_k(struct fheap *h, size_t k,
+                                  struct fheap_node *out[]);
+/* Write the shape of the heap into 's', walking
+ * all nodes once without recursion. */
+static inline void fheap_stats(struct fheap *h, struct fheap_stats *s);
 
 /* Fibonacci-heap node utility functions. */
 
@@ -89,6 +163,8 @@ fheap_node_init(struct fheap_node *n)
 static inline struct fheap_node *
 fheap_node_link(struct fheap_node *a, struct fheap_node *b)
 {
+    FHEAP_INSTR(link);
+    FHEAP_USDT_LINK();
     if (a->next) {
         a->next->prev = b;
         b->next = a->next;
@@ -165,6 +241,7 @@ fheap_node_level_orphan(struct fheap_node *n)
     }
 
     do {
+        FHEAP_INSTR(deref);
         n->parent = NULL;
         n = n->next;
     } while (n);
@@ -192,7 +269,9 @@ fheap_node_level_merge(struct fheap *h,
     }
 
     end = l1;
-    for (end = l1; end && end->next; end = end->next);
+    for (end = l1; end && end->next; end = end->next) {
+        FHEAP_INSTR(deref);
+    }
     if (end) {
         end->next = l2;
         l2->prev = end;
@@ -207,12 +286,14 @@ fheap_node_cut(struct fheap *h, struct fheap_node *n)
     fheap_node_level_cut(n);
     n->mark = false;
     h->root = fheap_node_add_peer(h, h->root, n);
+    FHEAP_COUNT(h, n_roots, 1);
 }
 
 static inline void
 fheap_node_cascade(struct fheap *h, struct fheap_node *n)
 {
     while (n && n->parent) {
+        FHEAP_INSTR(deref);
         if (n->mark == false) {
             n->mark = true;
             break;
@@ -245,8 +326,7 @@ fheap_peek(struct fheap *h)
 static inline void
 fheap_consolidate(struct fheap *h)
 {
-    const int n_ranks = 64;
-    struct fheap_node *ranks[n_ranks];
+    struct fheap_node *ranks[FHEAP_N_RANKS];
     struct fheap_node *n;
     size_t max_rank = 0;
 
@@ -254,11 +334,13 @@ fheap_consolidate(struct fheap *h)
         return;
     }
 
+    FHEAP_PROBE(consolidate_entry, h);
     memset(ranks, 0, sizeof ranks);
 
     FHEAP_NODE_FOREACH_PEER (n, h->root) {
         size_t r = n->rank;
 
+        FHEAP_INSTR(deref);
         fheap_node_level_cut(n);
         while (ranks[r] != NULL) {
             if (fheap_prop(h, n, ranks[r])) {
@@ -267,6 +349,7 @@ fheap_consolidate(struct fheap *h)
                 fheap_node_add_child(h, ranks[r], n);
                 n = ranks[r];
             }
+            FHEAP_COUNT(h, n_roots, -1);
             ranks[r++] = NULL;
         }
         ranks[r] = n;
@@ -279,6 +362,7 @@ fheap_consolidate(struct fheap *h)
     for (size_t i = 0; i < max_rank; i++) {
         h->root = fheap_node_add_peer(h, h->root, ranks[i]);
     }
+    FHEAP_PROBE(consolidate_return, h);
 }
 
 static inline struct fheap_node *
@@ -292,11 +376,14 @@ fheap_pop(struct fheap *h)
         return NULL;
     }
 
+    FHEAP_PROBE(pop_entry, h);
     /* Take references before cutting the root. */
     child = root->child;
     next = root->next;
 
     /* Isolate the root from its peers. */
+    FHEAP_COUNT(h, n, -1);
+    FHEAP_COUNT(h, n_roots, root->rank - 1);
     fheap_node_level_cut(root);
     fheap_node_level_orphan(child);
 
@@ -304,6 +391,7 @@ fheap_pop(struct fheap *h)
     h->root = fheap_node_level_merge(h, next, child);
 
     fheap_consolidate(h);
+    FHEAP_PROBE(pop_return, h);
 
     return root;
 }
@@ -311,15 +399,23 @@ fheap_pop(struct fheap *h)
 static inline void
 fheap_insert(struct fheap *h, struct fheap_node *node)
 {
+    FHEAP_PROBE(insert_entry, h);
     fheap_node_init(node);
     h->root = fheap_node_add_peer(h, h->root, node);
+    FHEAP_COUNT(h, n, 1);
+    FHEAP_COUNT(h, n_roots, 1);
+    FHEAP_PROBE(insert_return, h);
 }
 
 static inline void
 fheap_merge(struct fheap *dst, struct fheap *src)
 {
     if (dst->cmp == src->cmp) {
+        FHEAP_PROBE(merge_entry, dst);
         dst->root = fheap_node_level_merge(dst, dst->root, src->root);
+        FHEAP_COUNT(dst, n, src->counters.n);
+        FHEAP_COUNT(dst, n_roots, src->counters.n_roots);
+        FHEAP_PROBE(merge_return, dst);
     }
 }
 
@@ -330,9 +426,14 @@ fheap_reinsert(struct fheap *h, struct fheap_node *n)
 
     if (n == fheap_peek(h)) {
         new_heap.root = fheap_pop(h);
+        FHEAP_COUNT(&new_heap, n, 1);
+        FHEAP_COUNT(&new_heap, n_roots, 1);
     } else {
         struct fheap_node *child = n->child;
 
+        /* 'n' and its children move to the root list. */
+        FHEAP_COUNT(h, n_roots, n->parent == NULL ? -1 : 0);
+        FHEAP_COUNT(&new_heap, n_roots, 1 + n->rank);
         fheap_node_level_cut(n);
         fheap_node_level_orphan(child);
         new_heap.root = fheap_node_level_merge(h, n, child);
@@ -342,7 +443,7 @@ fheap_reinsert(struct fheap *h, struct fheap_node *n)
 }
 
 static inline void
-fheap_update_key(struct fheap *h, struct fheap_node *n)
+fheap_update_key_(struct fheap *h, struct fheap_node *n)
 {
     struct fheap_node *c;
 
@@ -361,6 +462,7 @@ fheap_update_key(struct fheap *h, struct fheap_node *n)
     }
 
     FHEAP_NODE_FOREACH_CHILD (c, n) {
+        FHEAP_INSTR(deref);
         if (!fheap_prop(h, n, c)) {
             fheap_reinsert(h, n);
             return;
@@ -368,4 +470,133 @@ fheap_update_key(struct fheap *h, struct fheap_node *n)
     }
 }
 
+static inline void
+fheap_update_key(struct fheap *h, struct fheap_node *n)
+{
+    FHEAP_PROBE(update_key_entry, h);
+    fheap_update_key_(h, n);
+    FHEAP_PROBE(update_key_return, h);
+}
+
+/* Candidates of 'peek_k' are kept in a heap whose
+ * top is the last one in the order of 'h'. */
+static inline void
+fheap_cand_down(struct fheap *h, struct fheap_node *out[], size_t i, size_t n)
+{
+    struct fheap_node *tmp;
+    size_t next;
+
+    while ((next = (2 * i + 1)), next < n) {
+        next += (next + 1 < n && h->cmp(out[next + 1], out[next]) > 0);
+        if (h->cmp(out[next], out[i]) <= 0) {
+            break;
+        }
+        tmp = out[i];
+        out[i] = out[next];
+        out[next] = tmp;
+        i = next;
+    }
+}
+
+/* Consider 'node' for 'peek_k'. Returns false if its
+ * subtree cannot hold any of the first 'k' nodes. */
+static inline bool
+fheap_peek_k_visit(struct fheap *h, struct fheap_node *node, size_t k,
+                   struct fheap_node *out[], size_t *n)
+{
+    struct fheap_node *tmp;
+    size_t j, parent;
+
+    if (*n == k) {
+        if (h->cmp(out[0], node) <= 0) {
+            return false;
+        }
+        out[0] = node;
+        fheap_cand_down(h, out, 0, k);
+        return true;
+    }
+
+    j = (*n)++;
+    out[j] = node;
+    while ((parent = (j - 1) / 2), j > 0 &&
+           h->cmp(out[j], out[parent]) > 0) {
+        tmp = out[j];
+        out[j] = out[parent];
+        out[parent] = tmp;
+        j = parent;
+    }
+    return true;
+}
+
+static inline size_t
+fheap_peek_k(struct fheap *h, size_t k, struct fheap_node *out[])
+{
+    struct fheap_node *node = h->root;
+    struct fheap_node *tmp;
+    size_t n = 0;
+    size_t i;
+
+    if (k == 0) {
+        return 0;
+    }
+
+    /* Walk each tree of the root list in pre-order, without a stack. */
+    while (node != NULL) {
+        if (fheap_peek_k_visit(h, node, k, out, &n) && node->child != NULL) {
+            node = node->child;
+            continue;
+        }
+        while (node->next == NULL && node->parent != NULL) {
+            node = node->parent;
+        }
+        node = node->next;
+    }
+
+    /* Sort the candidates, the last one being at the top. */
+    for (i = n; i > 1; i--) {
+        tmp = out[0];
+        out[0] = out[i - 1];
+        out[i - 1] = tmp;
+        fheap_cand_down(h, out, 0, i - 1);
+    }
+    return n;
+}
+
+static inline void
+fheap_stats(struct fheap *h, struct fheap_stats *s)
+{
+    struct fheap_node *node = h->root;
+    size_t depth = 0;
+    int rank;
+
+    memset(s, 0, sizeof *s);
+
+    FHEAP_NODE_FOREACH_PEER (node, h->root) {
+        s->n_roots++;
+    }
+
+    /* Same walk as 'peek_k', keeping track of the depth. */
+    node = h->root;
+    while (node != NULL) {
+        s->n++;
+        s->n_marked += node->mark;
+        if (s->depth < depth) {
+            s->depth = depth;
+        }
+        rank = node->rank < FHEAP_N_RANKS ? node->rank : FHEAP_N_RANKS - 1;
+        s->ranks[rank]++;
+
+        if (node->child != NULL) {
+            node = node->child;
+            depth++;
+            continue;
+        }
+        while (node->next == NULL && node->parent != NULL) {
+            node = node->parent;
+            depth--;
+        }
+        node = node->next;
+    }
+}
+
 #endif /* _FIBONACCI_HEAP_H_ */
@@ -0,0 +1,349 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef _MINMAX_HEAP_H_
+#define _MINMAX_HEAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Min-max heap.
+ *
+ * This is a double-ended heap as described by Atkinson et al. in 1986,
+ * giving access to both its min and max elements.
+ *
+ * Like the binary heap, it is implemented as a contiguous array of small
+ * containers, each pointing to arbitrary data and keeping a priority value
+ * within, for fast local access. Levels of the implicit tree alternate
+ * between 'min' levels, where a node precedes all its descendants,
+ * and 'max' levels, where a node follows all its descendants.
+ * The root is thus the min element, and the max is one of its children.
+ *
+ * The backing array is reallocated as necessary during insertion,
+ * and freed once all elements have been removed from the heap.
+ *
+ * Elements are updated and removed using their index within the array.
+ * To avoid searching for it, a container can point to an index
+ * that will be kept up-to-date as the container moves within the heap:
+ * set its 'index' field to the location of a 'size_t' in the data.
+ * If left NULL, 'mmheap_find' can be used to search for it.
+ *
+ * The min and max are defined by the comparison function, the
+ * min element being the first one in the resulting order.
+ *
+ * The work done by the heap can be measured by defining
+ * 'MMHEAP_INSTR(EV)' before including this file. It is then called
+ * with 'link' for each swap of containers and 'alloc' when the
+ * array is reallocated. It does nothing otherwise.
+ */
+
+#ifndef MMHEAP_INSTR
+#define MMHEAP_INSTR(EV) ((void) 0)
+#endif
+
+struct mmheap_node {
+    void *data;
+    union {
+        uint32_t u32;
+        long long int lli;
+    } priority;
+    size_t *index;
+};
+
+typedef int (*mmheap_cmp)(struct mmheap_node *a, struct mmheap_node *b);
+
+struct mmheap {
+    mmheap_cmp cmp;
+    struct mmheap_node *entries;
+    size_t capacity;
+    size_t n;
+};
+
+#define MMHEAP_INITIALIZER(CMP) { \
+    .cmp = CMP, .entries = NULL, \
+    .capacity = 0, .n = 0, \
+}
+
+/* Shape of a min-max heap. */
+struct mmheap_stats {
+    size_t n;
+    /* Allocated containers not in use. */
+    size_t slack;
+    /* Number of levels of the tree. */
+    size_t depth;
+};
+
+/* Min-max heap interface. */
+
+static inline void mmheap_init(struct mmheap *h, mmheap_cmp cmp);
+static inline bool mmheap_is_empty(struct mmheap *h);
+static inline void *mmheap_peek_min(struct mmheap *h);
+static inline void *mmheap_peek_max(struct mmheap *h);
+static inline void *mmheap_pop_min(struct mmheap *h);
+static inline void *mmheap_pop_max(struct mmheap *h);
+static inline void mmheap_insert(struct mmheap *h, struct mmheap_node n);
+/* Returns the index of the container pointing to 'data',
+ * or the number of elements in the heap if none does. */
+static inline size_t mmheap_find(struct mmheap *h, void *data);
+/* Replace the container at index 'i' by 'n', usually
+ * the same data with an updated priority. */
+static inline void mmheap_update_key(struct mmheap *h, size_t i,
+                                     struct mmheap_node n);
+/* Remove the container at index 'i' and returns its data. */
+static inline void *mmheap_remove(struct mmheap *h, size_t i);
+/* Write the shape of the heap into 's'. */
+static inline void mmheap_stats(struct mmheap *h, struct mmheap_stats *s);
+
+/* Utility functions, used to implement
+ * the above operations. Do not call directly. */
+
+#define MMHEAP_PARENT(i) (((i) - 1) / 2)
+#define MMHEAP_CHILD(i) (2 * (i) + 1)
+#define MMHEAP_GRANDCHILD(i) (4 * (i) + 3)
+
+static inline bool
+mmheap_is_max_level(size_t i)
+{
+    /* The level of 'i' is floor(log2(i + 1)). */
+    return (63 - __builtin_clzll((unsigned long long) i + 1)) & 1;
+}
+
+static inline void
+mmheap_set(struct mmheap *h, size_t i, struct mmheap_node n)
+{
+    h->entries[i] = n;
+    if (n.index != NULL) {
+        *n.index = i;
+    }
+}
+
+static inline void
+mmheap_swap(struct mmheap *h, size_t i, size_t j)
+{
+    struct mmheap_node tmp = h->entries[i];
+
+    MMHEAP_INSTR(link);
+    mmheap_set(h, i, h->entries[j]);
+    mmheap_set(h, j, tmp);
+}
+
+/* Returns true if 'a' must be above 'b' on a
+ * max level if 'max' is set, on a min level otherwise. */
+static inline bool
+mmheap_before(struct mmheap *h, size_t a, size_t b, bool max)
+{
+    int c = h->cmp(&h->entries[a], &h->entries[b]);
+
+    return max ? c > 0 : c < 0;
+}
+
+/* Move 'i' up through its grandparents, all
+ * on the same kind of level. Returns true if it moved. */
+static inline bool
+mmheap_up_chain(struct mmheap *h, size_t i, bool max)
+{
+    bool moved = false;
+    size_t gp;
+
+    while (i > 2 &&
+           (gp = MMHEAP_PARENT(MMHEAP_PARENT(i)),
+            mmheap_before(h, i, gp, max))) {
+        mmheap_swap(h, i, gp);
+        i = gp;
+        moved = true;
+    }
+    return moved;
+}
+
+static inline void
+mmheap_down(struct mmheap *h, size_t i)
+{
+    bool max = mmheap_is_max_level(i);
+    size_t first, last, m, j;
+
+    while ((first = MMHEAP_CHILD(i)) < h->n) {
+        /* Find the first among children and grandchildren. */
+        m = first;
+        if (first + 1 < h->n && mmheap_before(h, first + 1, m, max)) {
+            m = first + 1;
+        }
+        first = MMHEAP_GRANDCHILD(i);
+        last = first + 4 < h->n ? first + 4 : h->n;
+        for (j = first; j < last; j++) {
+            if (mmheap_before(h, j, m, max)) {
+                m = j;
+            }
+        }
+
+        if (!mmheap_before(h, m, i, max)) {
+            break;
+        }
+        mmheap_swap(h, i, m);
+        if (m < first) {
+            /* A child: its subtree is untouched. */
+            break;
+        }
+        if (mmheap_before(h, m, MMHEAP_PARENT(m), !max)) {
+            mmheap_swap(h, m, MMHEAP_PARENT(m));
+        }
+        i = m;
+    }
+}
+
+/* Restore the heap invariant after the container
+ * at index 'i' was replaced. */
+static inline void
+mmheap_fix(struct mmheap *h, size_t i)
+{
+    bool max = mmheap_is_max_level(i);
+
+    if (i > 0 && mmheap_before(h, i, MMHEAP_PARENT(i), !max)) {
+        size_t p = MMHEAP_PARENT(i);
+
+        /* The new element precedes the whole subtree of its
+         * parent in the order of the parent level. */
+        mmheap_swap(h, i, p);
+        mmheap_up_chain(h, p, !max);
+        mmheap_down(h, i);
+    } else if (!mmheap_up_chain(h, i, max)) {
+        mmheap_down(h, i);
+    }
+}
+
+static inline size_t
+mmheap_max_index(struct mmheap *h)
+{
+    if (h->n < 3) {
+        return h->n - 1;
+    }
+    return mmheap_before(h, 2, 1, true) ? 2 : 1;
+}
+
+static inline bool
+mmheap_realloc(struct mmheap *h, size_t n)
+{
+    size_t c = h->capacity;
+    void *p;
+
+    if (n > c) {
+        size_t delta = (1.75 * c) - c;
+        c += delta ? delta : 1;
+        MMHEAP_INSTR(alloc);
+        p = realloc(h->entries, c * sizeof(h->entries[0]));
+        if (p == NULL) {
+            return false;
+        }
+        h->entries = p;
+        h->capacity = c;
+    }
+    return true;
+}
+
+static inline void
+mmheap_init(struct mmheap *h, mmheap_cmp cmp)
+{
+    *h = (struct mmheap) MMHEAP_INITIALIZER(cmp);
+}
+
+static inline bool
+mmheap_is_empty(struct mmheap *h)
+{
+    return h->n == 0;
+}
+
+static inline void *
+mmheap_peek_min(struct mmheap *h)
+{
+    return mmheap_is_empty(h) ? NULL : h->entries[0].data;
+}
+
+static inline void *
+mmheap_peek_max(struct mmheap *h)
+{
+    return mmheap_is_empty(h) ? NULL : h->entries[mmheap_max_index(h)].data;
+}
+
+static inline void *
+mmheap_remove(struct mmheap *h, size_t i)
+{
+    void *data;
+
+    if (i >= h->n) {
+        return NULL;
+    }
+
+    data = h->entries[i].data;
+    h->n -= 1;
+    if (i != h->n) {
+        mmheap_set(h, i, h->entries[h->n]);
+        mmheap_fix(h, i);
+    }
+
+    if (h->n == 0) {
+        free(h->entries);
+        h->entries = NULL;
+        h->capacity = 0;
+    }
+
+    return data;
+}
+
+static inline void *
+mmheap_pop_min(struct mmheap *h)
+{
+    return mmheap_is_empty(h) ? NULL : mmheap_remove(h, 0);
+}
+
+static inline void *
+mmheap_pop_max(struct mmheap *h)
+{
+    return mmheap_is_empty(h) ? NULL : mmheap_remove(h, mmheap_max_index(h));
+}
+
+static inline void
+mmheap_insert(struct mmheap *h, struct mmheap_node n)
+{
+    if (!mmheap_realloc(h, h->n + 1)) {
+        return;
+    }
+
+    mmheap_set(h, h->n, n);
+    h->n += 1;
+    mmheap_fix(h, h->n - 1);
+}
+
+static inline size_t
+mmheap_find(struct mmheap *h, void *data)
+{
+    size_t i;
+
+    for (i = 0; i < h->n; i++) {
+        if (h->entries[i].data == data) {
+            break;
+        }
+    }
+    return i;
+}
+
+static inline void
+mmheap_update_key(struct mmheap *h, size_t i, struct mmheap_node n)
+{
+    if (i < h->n) {
+        mmheap_set(h, i, n);
+        mmheap_fix(h, i);
+    }
+}
+
+static inline void
+mmheap_stats(struct mmheap *h, struct mmheap_stats *s)
+{
+    *s = (struct mmheap_stats) {
+        .n = h->n,
+        .slack = h->capacity - h->n,
+        .depth = h->n ? 64 - __builtin_clzll((unsigned long long) h->n) : 0,
+    };
+}
+
+#endif /* _MINMAX_HEAP_H_ */
@@ -27,6 +27,24 @@
  * iteratively instead of recursively. After many insertions, pairing is done
  * on a possibly large list of nodes. Recursive implementation then usually
  * stack-overflow on the next removal.
+ *
+ * The shape of the heap can be inspected with 'pheap_stats'. Defining
+ * PHEAP_COUNTERS before including this file also maintains the number
+ * of nodes within the heap, readable at any time in 'counters'.
+ *
+ * The work done by the heap can be measured by defining
+ * 'PHEAP_INSTR(EV)' before including this file. It is then called
+ * with 'link' when a node becomes the child of another, and 'deref'
+ * for each node reached while walking sibling lists. It does nothing
+ * otherwise. Comparisons are left to the comparison function.
+ *
+ * Defining PHEAP_USDT places USDT probes from <sys/sdt.h> at the
+ * entry and return of insert, pop, merge and reinsert, named after
+ * the operation with an '_entry' or '_return' suffix. Their arguments
+ * are the heap, its number of nodes and the running count of links
+ * made in the current thread: the difference between the return and
+ * the entry of an operation is the work it did. The counters are then
+ * enabled. Without PHEAP_USDT, the probes compile to nothing.
  */
 
 struct pheap_node {
@@ -45,9 +63,53 @@ struct pheap_node {
 
 typedef int (*pheap_cmp)(struct pheap_node *a, struct pheap_node *b);
 
+#ifndef PHEAP_INSTR
+#define PHEAP_INSTR(EV) ((void) 0)
+#endif
+
+#ifdef PHEAP_USDT
+#include <sys/sdt.h>
+#ifndef PHEAP_COUNTERS
+#define PHEAP_COUNTERS
+#endif
+/* Links made by the pairing heaps of the current thread. */
+static _Thread_local unsigned long long int pheap_usdt_links;
+#define PHEAP_USDT_LINK() ((void) pheap_usdt_links++)
+#define PHEAP_PROBE(NAME, H) \
+    STAP_PROBE3(pheap, NAME, (H), (H)->counters.n, pheap_usdt_links)
+#else
+#define PHEAP_USDT_LINK() ((void) 0)
+#define PHEAP_PROBE(NAME, H) ((void) 0)
+#endif
+
+struct pheap_counters {
+    size_t n;
+};
+
 struct pheap {
     struct pheap_node *root;
     pheap_cmp cmp;
+#ifdef PHEAP_COUNTERS
+    struct pheap_counters counters;
+#endif
+};
+
+#ifdef PHEAP_COUNTERS
+#define PHEAP_COUNT(H, FIELD, D) ((H)->counters.FIELD += (D))
+#else
+#define PHEAP_COUNT(H, FIELD, D) ((void) 0)
+#endif
+
+/* Shape of a pairing heap. */
+struct pheap_stats {
+    /* Number of nodes. */
+    size_t n;
+    /* Number of children of the root: the length
+     * of the list paired on the next removal. */
+    size_t root_degree;
+    size_t max_degree;
+    /* Longest path from the root, in number of links. */
+    size_t depth;
 };
 
 #define PHEAP_INITIALIZER(CMP) { \
@@ -102,6 +164,21 @@ static inline void pheap_merge(struct pheap *dst, struct pheap *src);
  */
 static inline void pheap_reinsert(struct pheap *h, struct pheap_node *n);
 
+/* Write the first 'k' nodes of the heap in order into 'out',
+ * without modifying it. Returns the number of nodes written.
+ *
+ * Subtrees are walked as long as they can hold one of the 'k' first
+ * nodes seen so far, kept in a heap within 'out' itself: no memory
+ * is allocated. The cost thus depends on the number of children
+ * of the nodes found, at worst all nodes after many insertions. */
+static inline size_t pheap_peek_k(struct pheap *h, size_t k,
+                                  struct pheap_node *out[]);
+
+/* Write the shape of the heap into 's', walking all nodes once
+ * without recursion. Long root lists announce a costly removal,
+ * deep trees a costly key update. */
+static inline void pheap_stats(struct pheap *h, struct pheap_stats *s);
+
 /* Pairing-heap node utility functions. */
 
 #define PHEAP_NODE_FOREACH_CHILD(i, n) \
@@ -118,6 +195,8 @@ pheap_node_add_child(struct pheap_node *head, struct pheap_node *n)
 {
     struct pheap_node *child = head->child;
 
+    PHEAP_INSTR(link);
+    PHEAP_USDT_LINK();
     n->parent = head;
     n->next = child;
     if (child != NULL) {
@@ -187,9 +266,11 @@ pheap_node_pairwise_merge(struct pheap_node *n, pheap_cmp cmp)
 
     a = n;
     while (a != NULL) {
+        PHEAP_INSTR(deref);
         b = a->next;
         pheap_node_unlink(a);
         if (b != NULL) {
+            PHEAP_INSTR(deref);
             next = b->next;
             pheap_node_unlink(b);
         } else {
@@ -229,27 +310,37 @@ pheap_pop(struct pheap *h)
 {
     struct pheap_node *top = pheap_peek(h);
 
+    PHEAP_PROBE(pop_entry, h);
     if (top != NULL) {
         h->root = pheap_node_pairwise_merge(top->child, h->cmp);
         pheap_node_init(top);
+        PHEAP_COUNT(h, n, -1);
     }
+    PHEAP_PROBE(pop_return, h);
     return top;
 }
 
 static inline void
 pheap_insert(struct pheap *h, struct pheap_node *node)
 {
+    PHEAP_PROBE(insert_entry, h);
     /* Assume the node was never user before. */
     pheap_node_init(node);
     h->root = pheap_node_merge(h->root, node, h->cmp);
+    PHEAP_COUNT(h, n, 1);
+    PHEAP_PROBE(insert_return, h);
 }
 
 static inline void
 pheap_merge(struct pheap *dst, struct pheap *src)
 {
     if (dst->cmp == src->cmp) {
+        PHEAP_PROBE(merge_entry, dst);
         dst->root = pheap_node_merge(dst->root, src->root, dst->cmp);
         src->root = NULL;
+        PHEAP_COUNT(dst, n, src->counters.n);
+        PHEAP_COUNT(src, n, -src->counters.n);
+        PHEAP_PROBE(merge_return, dst);
     }
 }
 
@@ -261,9 +352,11 @@ pheap_reinsert(struct pheap *h, struct pheap_node *n)
 {
     struct pheap new_heap = PHEAP_INITIALIZER(h->cmp);
 
+    PHEAP_PROBE(reinsert_entry, h);
     /* Remove 'n' from 'h'. */
     if (n == pheap_peek(h)) {
         new_heap.root = pheap_pop(h);
+        PHEAP_COUNT(&new_heap, n, 1);
     } else {
         struct pheap_node *child;
 
@@ -275,6 +368,152 @@ pheap_reinsert(struct pheap *h, struct pheap_node *n)
 
     /* Insert 'n' back into 'h'. */
     pheap_merge(h, &new_heap);
+    PHEAP_PROBE(reinsert_return, h);
+}
+
+/* Returns the parent of 'n', which must not be the root. */
+static inline struct pheap_node *
+pheap_node_parent(struct pheap_node *n)
+{
+    /* Only the first child points to its parent. */
+    while (n->prev->child != n) {
+        n = n->prev;
+    }
+    return n->parent;
+}
+
+/* Candidates of 'peek_k' are kept in a heap whose
+ * top is the last one in the order of 'h'. */
+static inline void
+pheap_cand_down(struct pheap *h, struct pheap_node *out[], size_t i, size_t n)
+{
+    struct pheap_node *tmp;
+    size_t next;
+
+    while ((next = (2 * i + 1)), next < n) {
+        next += (next + 1 < n && h->cmp(out[next + 1], out[next]) > 0);
+        if (h->cmp(out[next], out[i]) <= 0) {
+            break;
+        }
+        tmp = out[i];
+        out[i] = out[next];
+        out[next] = tmp;
+        i = next;
+    }
+}
+
+/* Consider 'node' for 'peek_k'. Returns false if its
+ * subtree cannot hold any of the first 'k' nodes. */
+static inline bool
+pheap_peek_k_visit(struct pheap *h, struct pheap_node *node, size_t k,
+                   struct pheap_node *out[], size_t *n)
+{
+    struct pheap_node *tmp;
+    size_t j, parent;
+
+    if (*n == k) {
+        if (h->cmp(out[0], node) <= 0) {
+            return false;
+        }
+        out[0] = node;
+        pheap_cand_down(h, out, 0, k);
+        return true;
+    }
+
+    j = (*n)++;
+    out[j] = node;
+    while ((parent = (j - 1) / 2), j > 0 &&
+           h->cmp(out[j], out[parent]) > 0) {
+        tmp = out[j];
+        out[j] = out[parent];
+        out[parent] = tmp;
+        j = parent;
+    }
+    return true;
+}
+
+static inline size_t
+pheap_peek_k(struct pheap *h, size_t k, struct pheap_node *out[])
+{
+    struct pheap_node *node = h->root;
+    struct pheap_node *tmp;
+    size_t n = 0;
+    size_t i;
+
+    if (k == 0 || pheap_is_empty(h)) {
+        return 0;
+    }
+
+    /* Walk the tree in pre-order, without a stack. */
+    for (;;) {
+        if (pheap_peek_k_visit(h, node, k, out, &n) && node->child != NULL) {
+            node = node->child;
+            continue;
+        }
+        while (node != h->root && node->next == NULL) {
+            node = pheap_node_parent(node);
+        }
+        if (node == h->root) {
+            break;
+        }
+        node = node->next;
+    }
+
+    /* Sort the candidates, the last one being at the top. */
+    for (i = n; i > 1; i--) {
+        tmp = out[0];
+        out[0] = out[i - 1];
+        out[i - 1] = tmp;
+        pheap_cand_down(h, out, 0, i - 1);
+    }
+    return n;
+}
+
+static inline void
+pheap_stats(struct pheap *h, struct pheap_stats *s)
+{
+    struct pheap_node *node = h->root;
+    size_t depth = 0;
+    size_t degree;
+    struct pheap_node *c;
+
+    *s = (struct pheap_stats) { .n = 0, };
+    if (pheap_is_empty(h)) {
+        return;
+    }
+
+    PHEAP_NODE_FOREACH_CHILD(c, h->root) {
+        s->root_degree++;
+    }
+
+    /* Same walk as 'peek_k', keeping track of the depth. */
+    for (;;) {
+        s->n++;
+        if (s->depth < depth) {
+            s->depth = depth;
+        }
+        degree = 0;
+        PHEAP_NODE_FOREACH_CHILD(c, node) {
+            degree++;
+        }
+        if (s->max_degree < degree) {
+            s->max_degree = degree;
+        }
+
+        if (node->child != NULL) {
+            node = node->child;
+            depth++;
+            continue;
+        }
+        while (node != h->root && node->next == NULL) {
+            node = pheap_node_parent(node);
+            depth--;
+        }
+        if (node == h->root) {
+            break;
+        }
+        node = node->next;
+    }
 }
 
 #endif /* _PAIRING_HEAP_H_ */
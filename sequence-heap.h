@@ -0,0 +1,494 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef _SEQUENCE_HEAP_H_
+#define _SEQUENCE_HEAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Sequence heap.
+ *
+ * This is a simplified version of the cache-efficient priority queue
+ * described by P. Sanders in 'Fast Priority Queues for Cached Memory'.
+ *
+ * Like the binary heap, elements are small containers pointing to
+ * arbitrary data and keeping a priority value within. They are
+ * stored in three kinds of places:
+ *
+ *   - A small insertion heap, a bounded binary heap receiving
+ *     new elements.
+ *
+ *   - Sorted runs, arranged in groups. When the insertion heap is full,
+ *     it is sorted and becomes a new run in the first group. When a group
+ *     holds 'SHEAP_K' runs, they are merged into a single run that moves
+ *     to the next group. Each element is thus merged a logarithmic number
+ *     of times, always reading and writing memory sequentially.
+ *
+ *   - A small sorted deletion buffer, refilled by merging the smallest
+ *     elements of all runs. All elements in the deletion buffer precede
+ *     those in runs.
+ *
+ * The top element is the first of either the insertion heap
+ * or the deletion buffer. Except for these small buffers of fixed size,
+ * elements are only accessed sequentially, making this heap efficient
+ * once the number of elements largely exceeds the caches.
+ *
+ * Runs are allocated when the insertion heap is flushed and when groups
+ * are merged, and freed once consumed. All elements must be removed to
+ * avoid leaks, by repeatedly using 'pop' until 'is_empty' becomes true.
+ *
+ * Key updates are not supported.
+ *
+ * The work done by the heap can be measured by defining
+ * 'SHEAP_INSTR(EV)' before including this file. It is then called
+ * with 'link' for each move of a container, within the insertion heap
+ * or by merging, 'deref' for each run reached while merging and
+ * 'alloc' when a run is allocated. It does nothing otherwise.
+ */
+
+/* The geometry of the heap can be changed by defining
+ * these values before including this file. */
+
+/* Capacity of the insertion heap. */
+#ifndef SHEAP_INS_SIZE
+#define SHEAP_INS_SIZE 256
+#endif
+/* Capacity of the deletion buffer. */
+#ifndef SHEAP_DEL_SIZE
+#define SHEAP_DEL_SIZE 256
+#endif
+/* Number of runs per group, the merging degree. */
+#ifndef SHEAP_K
+#define SHEAP_K 16
+#endif
+/* Number of groups. The last one merges into itself. */
+#ifndef SHEAP_N_GROUPS
+#define SHEAP_N_GROUPS 8
+#endif
+
+#ifndef SHEAP_INSTR
+#define SHEAP_INSTR(EV) ((void) 0)
+#endif
+
+struct sheap_node {
+    void *data;
+    union {
+        uint32_t u32;
+        long long int lli;
+    } priority;
+};
+
+typedef int (*sheap_cmp)(struct sheap_node *a, struct sheap_node *b);
+
+struct sheap_run {
+    struct sheap_node *entries;
+    /* First remaining element. */
+    size_t head;
+    size_t n;
+};
+
+struct sheap_group {
+    struct sheap_run runs[SHEAP_K];
+    size_t n_runs;
+};
+
+struct sheap {
+    sheap_cmp cmp;
+    struct sheap_node ins[SHEAP_INS_SIZE];
+    size_t n_ins;
+    struct sheap_node del[SHEAP_DEL_SIZE];
+    size_t del_head;
+    size_t n_del;
+    struct sheap_group groups[SHEAP_N_GROUPS];
+    size_t n;
+};
+
+#define SHEAP_INITIALIZER(CMP) { \
+    .cmp = CMP, .n_ins = 0, \
+    .del_head = 0, .n_del = 0, \
+    .n = 0, \
+}
+
+/* Shape of a sequence heap. */
+struct sheap_stats {
+    size_t n;
+    /* Elements in the insertion heap and the deletion buffer. */
+    size_t n_ins;
+    size_t n_del;
+    /* Number of runs in each group, and their elements. */
+    size_t n_runs[SHEAP_N_GROUPS];
+    size_t n_run_elems;
+    /* Bytes allocated for runs, consumed elements included. */
+    size_t run_bytes;
+};
+
+/* Sequence heap interface. */
+
+static inline void sheap_init(struct sheap *h, sheap_cmp cmp);
+static inline bool sheap_is_empty(struct sheap *h);
+static inline void *sheap_peek(struct sheap *h);
+static inline void *sheap_pop(struct sheap *h);
+static inline void sheap_insert(struct sheap *h, struct sheap_node n);
+/* Write the shape of the heap into 's', without reading the runs. */
+static inline void sheap_stats(struct sheap *h, struct sheap_stats *s);
+
+/* Utility functions, used to implement
+ * the above operations. Do not call directly. */
+
+static inline bool
+sheap_lt(struct sheap *h, struct sheap_node *a, struct sheap_node *b)
+{
+    return (h->cmp(a, b) < 0);
+}
+
+static inline void
+sheap_swap(struct sheap_node *a, struct sheap_node *b)
+{
+    struct sheap_node tmp = *a;
+
+    SHEAP_INSTR(link);
+    *a = *b;
+    *b = tmp;
+}
+
+static inline void
+sheap_ins_up(struct sheap *h, size_t i)
+{
+    size_t parent;
+
+    while ((parent = (i - 1) / 2), i > 0 &&
+           sheap_lt(h, &h->ins[i], &h->ins[parent])) {
+        sheap_swap(&h->ins[i], &h->ins[parent]);
+        i = parent;
+    }
+}
+
+static inline void
+sheap_ins_down(struct sheap *h, size_t i, size_t size)
+{
+    size_t next;
+
+    while ((next = (2 * i + 1)), next < size) {
+        next += (next + 1 < size &&
+                 sheap_lt(h, &h->ins[next + 1], &h->ins[next]));
+        if (sheap_lt(h, &h->ins[i], &h->ins[next])) {
+            break;
+        }
+        sheap_swap(&h->ins[i], &h->ins[next]);
+        i = next;
+    }
+}
+
+static inline struct sheap_node *
+sheap_run_head(struct sheap_run *r)
+{
+    return &r->entries[r->head];
+}
+
+static inline bool
+sheap_run_lt(struct sheap *h, struct sheap_run *a, struct sheap_run *b)
+{
+    return sheap_lt(h, sheap_run_head(a), sheap_run_head(b));
+}
+
+static inline void
+sheap_runs_down(struct sheap *h, struct sheap_run **runs, size_t i, size_t size)
+{
+    struct sheap_run *tmp;
+    size_t next;
+
+    while ((next = (2 * i + 1)), next < size) {
+        next += (next + 1 < size &&
+                 sheap_run_lt(h, runs[next + 1], runs[next]));
+        if (sheap_run_lt(h, runs[i], runs[next])) {
+            break;
+        }
+        tmp = runs[i];
+        runs[i] = runs[next];
+        runs[next] = tmp;
+        i = next;
+    }
+}
+
+/* Write at most 'limit' of the first elements of 'runs' into 'out',
+ * consuming them. Runs must not be empty. Returns the number written. */
+static inline size_t
+sheap_merge(struct sheap *h, struct sheap_run **runs, size_t n_runs,
+            struct sheap_node *out, size_t limit)
+{
+    size_t count = 0;
+    size_t i;
+
+    for (i = n_runs / 2; i-- > 0;) {
+        sheap_runs_down(h, runs, i, n_runs);
+    }
+
+    while (n_runs > 0 && count < limit) {
+        struct sheap_run *r = runs[0];
+
+        SHEAP_INSTR(deref);
+        SHEAP_INSTR(link);
+        out[count++] = r->entries[r->head++];
+        if (r->head == r->n) {
+            runs[0] = runs[--n_runs];
+        }
+        sheap_runs_down(h, runs, 0, n_runs);
+    }
+
+    return count;
+}
+
+static inline void
+sheap_group_remove_empty(struct sheap_group *g)
+{
+    size_t i = 0;
+
+    while (i < g->n_runs) {
+        struct sheap_run *r = &g->runs[i];
+
+        if (r->head == r->n) {
+            free(r->entries);
+            *r = g->runs[--g->n_runs];
+        } else {
+            i++;
+        }
+    }
+}
+
+/* Merge all runs of group 'i' into a single run. */
+static inline bool
+sheap_group_merge(struct sheap *h, size_t i, struct sheap_run *run)
+{
+    struct sheap_group *g = &h->groups[i];
+    struct sheap_run *runs[SHEAP_K];
+    size_t total = 0;
+    size_t j;
+
+    for (j = 0; j < g->n_runs; j++) {
+        runs[j] = &g->runs[j];
+        total += g->runs[j].n - g->runs[j].head;
+    }
+
+    SHEAP_INSTR(alloc);
+    run->entries = malloc(total * sizeof run->entries[0]);
+    if (run->entries == NULL) {
+        return false;
+    }
+    run->head = 0;
+    run->n = sheap_merge(h, runs, g->n_runs, run->entries, total);
+
+    sheap_group_remove_empty(g);
+    return true;
+}
+
+/* Add 'run' to group 'i', merging full groups
+ * into the next one as necessary. */
+static inline bool
+sheap_group_add(struct sheap *h, size_t i, struct sheap_run run)
+{
+    struct sheap_group *g = &h->groups[i];
+
+    if (g->n_runs == SHEAP_K) {
+        struct sheap_run merged;
+
+        if (!sheap_group_merge(h, i, &merged)) {
+            return false;
+        }
+        /* The last group merges into itself. If the next one
+         * fails to grow, the merged run also stays here. */
+        if (i + 1 == SHEAP_N_GROUPS ||
+            !sheap_group_add(h, i + 1, merged)) {
+            g->runs[g->n_runs++] = merged;
+        }
+    }
+
+    g->runs[g->n_runs++] = run;
+    return true;
+}
+
+/* Sort the insertion heap and merge it with the deletion buffer.
+ * The first elements go back to the deletion buffer,
+ * the others form a new run. */
+static inline bool
+sheap_flush(struct sheap *h)
+{
+    size_t n_del = h->n_del - h->del_head;
+    size_t total = h->n_ins + n_del;
+    struct sheap_node *sorted;
+    struct sheap_run run;
+    size_t a, b, k;
+
+    SHEAP_INSTR(alloc);
+    sorted = malloc(total * sizeof sorted[0]);
+    if (sorted == NULL) {
+        return false;
+    }
+
+    /* In-place heapsort, leaving the insertion heap in reverse order. */
+    for (k = h->n_ins; k > 1; k--) {
+        sheap_swap(&h->ins[0], &h->ins[k - 1]);
+        sheap_ins_down(h, 0, k - 1);
+    }
+
+    a = h->n_ins;
+    b = h->del_head;
+    for (k = 0; k < total; k++) {
+        if (b == h->n_del ||
+            (a > 0 && sheap_lt(h, &h->ins[a - 1], &h->del[b]))) {
+            sorted[k] = h->ins[--a];
+        } else {
+            sorted[k] = h->del[b++];
+        }
+    }
+
+    run = (struct sheap_run) {
+        .entries = sorted, .head = n_del, .n = total,
+    };
+    if (!sheap_group_add(h, 0, run)) {
+        free(sorted);
+        /* The insertion heap is now sorted in reverse order,
+         * restore its invariant. */
+        for (k = 1; k < h->n_ins; k++) {
+            sheap_ins_up(h, k);
+        }
+        return false;
+    }
+
+    memcpy(h->del, sorted, n_del * sizeof sorted[0]);
+    h->del_head = 0;
+    h->n_del = n_del;
+    h->n_ins = 0;
+
+    return true;
+}
+
+/* Refill the deletion buffer from all runs. */
+static inline void
+sheap_refill(struct sheap *h)
+{
+    struct sheap_run *runs[SHEAP_N_GROUPS * SHEAP_K];
+    size_t n_runs = 0;
+    size_t i, j;
+
+    for (i = 0; i < SHEAP_N_GROUPS; i++) {
+        for (j = 0; j < h->groups[i].n_runs; j++) {
+            runs[n_runs++] = &h->groups[i].runs[j];
+        }
+    }
+
+    h->del_head = 0;
+    h->n_del = sheap_merge(h, runs, n_runs, h->del, SHEAP_DEL_SIZE);
+
+    for (i = 0; i < SHEAP_N_GROUPS; i++) {
+        sheap_group_remove_empty(&h->groups[i]);
+    }
+}
+
+/* Returns the top container, or NULL if the heap is empty. */
+static inline struct sheap_node *
+sheap_top(struct sheap *h)
+{
+    struct sheap_node *d;
+
+    if (sheap_is_empty(h)) {
+        return NULL;
+    }
+
+    if (h->del_head == h->n_del && h->n > h->n_ins) {
+        sheap_refill(h);
+    }
+
+    if (h->del_head == h->n_del) {
+        return &h->ins[0];
+    }
+
+    d = &h->del[h->del_head];
+    if (h->n_ins > 0 && sheap_lt(h, &h->ins[0], d)) {
+        return &h->ins[0];
+    }
+    return d;
+}
+
+static inline void
+sheap_init(struct sheap *h, sheap_cmp cmp)
+{
+    *h = (struct sheap) SHEAP_INITIALIZER(cmp);
+}
+
+static inline bool
+sheap_is_empty(struct sheap *h)
+{
+    return h->n == 0;
+}
+
+static inline void *
+sheap_peek(struct sheap *h)
+{
+    struct sheap_node *top = sheap_top(h);
+
+    return top == NULL ? NULL : top->data;
+}
+
+static inline void *
+sheap_pop(struct sheap *h)
+{
+    struct sheap_node *top = sheap_top(h);
+    void *data;
+
+    if (top == NULL) {
+        return NULL;
+    }
+
+    data = top->data;
+    if (top == &h->ins[0]) {
+        h->n_ins -= 1;
+        h->ins[0] = h->ins[h->n_ins];
+        sheap_ins_down(h, 0, h->n_ins);
+    } else {
+        h->del_head += 1;
+    }
+    h->n -= 1;
+
+    return data;
+}
+
+static inline void
+sheap_insert(struct sheap *h, struct sheap_node n)
+{
+    if (h->n_ins == SHEAP_INS_SIZE && !sheap_flush(h)) {
+        return;
+    }
+
+    h->ins[h->n_ins] = n;
+    sheap_ins_up(h, h->n_ins);
+    h->n_ins += 1;
+    h->n += 1;
+}
+
+static inline void
+sheap_stats(struct sheap *h, struct sheap_stats *s)
+{
+    size_t i, j;
+
+    *s = (struct sheap_stats) {
+        .n = h->n,
+        .n_ins = h->n_ins,
+        .n_del = h->n_del - h->del_head,
+    };
+
+    for (i = 0; i < SHEAP_N_GROUPS; i++) {
+        struct sheap_group *g = &h->groups[i];
+
+        s->n_runs[i] = g->n_runs;
+        for (j = 0; j < g->n_runs; j++) {
+            s->n_run_elems += g->runs[j].n - g->runs[j].head;
+            s->run_bytes += g->runs[j].n * sizeof g->runs[j].entries[0];
+        }
+    }
+}
+
+#endif /* _SEQUENCE_HEAP_H_ */
@@ -0,0 +1,163 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "alloc.h"
+
+_Thread_local struct alloc_stats alloc_stats;
+
+#ifdef __GLIBC__
+
+#include <malloc.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void __libc_free(void *p);
+
+static bool alloc_enabled;
+
+bool
+alloc_enable(void)
+{
+    alloc_enabled = true;
+    return true;
+}
+
+static void
+alloc_count(void *p, size_t size)
+{
+    if (!alloc_enabled || p == NULL) {
+        return;
+    }
+    alloc_stats.n_allocs++;
+    alloc_stats.bytes += size;
+    alloc_stats.live += malloc_usable_size(p);
+    if (alloc_stats.live > alloc_stats.peak) {
+        alloc_stats.peak = alloc_stats.live;
+    }
+}
+
+static void
+alloc_uncount(void *p)
+{
+    if (alloc_enabled && p != NULL) {
+        alloc_stats.live -= malloc_usable_size(p);
+    }
+}
+
+void *
+malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+
+    alloc_count(p, size);
+    return p;
+}
+
+void *
+calloc(size_t count, size_t size)
+{
+    void *p = __libc_calloc(count, size);
+
+    alloc_count(p, count * size);
+    return p;
+}
+
+void *
+realloc(void *old, size_t size)
+{
+    size_t old_size = alloc_enabled && old ? malloc_usable_size(old) : 0;
+    void *p = __libc_realloc(old, size);
+
+    /* On failure, the old block is untouched. */
+    if (p != NULL || size == 0) {
+        alloc_stats.live -= old_size;
+    }
+    alloc_count(p, size);
+    return p;
+}
+
+void *
+memalign(size_t align, size_t size)
+{
+    void *p = __libc_memalign(align, size);
+
+    alloc_count(p, size);
+    return p;
+}
+
+void *
+aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+int
+posix_memalign(void **res, size_t align, size_t size)
+{
+    void *p;
+
+    if (align < sizeof(void *) || (align & (align - 1)) != 0) {
+        return EINVAL;
+    }
+    p = memalign(align, size);
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    *res = p;
+    return 0;
+}
+
+void
+free(void *p)
+{
+    alloc_uncount(p);
+    __libc_free(p);
+}
+
+#else
+
+bool
+alloc_enable(void)
+{
+    return false;
+}
+
+#endif
+
+long long int
+alloc_rss(void)
+{
+    /* Read without stdio, which would allocate. */
+    int fd = open("/proc/self/statm", O_RDONLY);
+    char buf[128];
+    char *s;
+    ssize_t n;
+
+    if (fd < 0) {
+        return -1;
+    }
+    n = read(fd, buf, sizeof buf - 1);
+    close(fd);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+
+    /* Total size, then resident pages. */
+    s = strchr(buf, ' ');
+    if (s == NULL) {
+        return -1;
+    }
+    return strtoll(s + 1, NULL, 10) * sysconf(_SC_PAGESIZE);
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Allocation accounting.
+ *
+ * The bench interposes the allocator: its own malloc, calloc, realloc
+ * and free forward to the C library, counting calls and bytes once
+ * enabled. Only the calls made by the current thread are counted.
+ *
+ * The C library must export its allocator under another name
+ * for it to be wrapped, as glibc does. Otherwise 'alloc_enable'
+ * returns false and nothing is counted.
+ */
+
+struct alloc_stats {
+    /* Calls to malloc, calloc, realloc and aligned allocators. */
+    unsigned long long int n_allocs;
+    /* Bytes requested by these calls. */
+    unsigned long long int bytes;
+    /* Usable bytes currently allocated, and their maximum. */
+    long long int live;
+    long long int peak;
+};
+
+extern _Thread_local struct alloc_stats alloc_stats;
+
+/* Start counting allocations. Returns false if unsupported. */
+bool alloc_enable(void);
+
+/* Set the peak to the bytes currently allocated. */
+static inline void
+alloc_peak_reset(void)
+{
+    alloc_stats.peak = alloc_stats.live;
+}
+
+/* Resident set size of the process in bytes, -1 if unknown. */
+long long int alloc_rss(void);
+
+#endif /* ALLOC_H */
@@ -5,7 +5,12 @@
 #ifndef BENCH_H
 #define BENCH_H
 
-#include "mov-avg.h"
+#include <stdio.h>
+
+#include "alloc.h"
+#include "heap.h"
+#include "histogram.h"
+#include "perf.h"
 #include "util.h"
 
 struct test_params {
@@ -16,15 +21,35 @@ struct test_params {
     /* Probability within [0, 100) that an element has
      * its priority updated and being re-inserted in the queue. */
     uint32_t p_update;
+    /* Probability within [0, 100) that a removal takes the max
+     * element instead, for double-ended heaps only. */
+    uint32_t p_shed;
 };
 
 #define TEST_PARAMS_INITIALIZER { \
     .name = NULL, \
     .n_elems = 0, .range = 0, .seed = 0, \
-    .p_update = 0, \
+    .p_update = 0, .p_shed = 0, \
 }
 
+/* Memory used by the heap during a test. */
+struct test_memory {
+    /* Allocations when the test started. */
+    struct alloc_stats base;
+    long long int rss_base;
+    /* Bytes allocated by the heap once all elements are inserted,
+     * and at most during the test. */
+    long long int live;
+    long long int peak;
+    unsigned long long int n_allocs;
+    unsigned long long int bytes;
+    /* Change of the resident set size once all elements are
+     * inserted, and at the end of the test. */
+    long long int rss[2];
+};
+
 struct test_results {
+    /* Start and end of each phase, in timer ticks. */
     union {
         struct {
             long long int start;
@@ -35,13 +60,17 @@ struct test_results {
     };
     long long int delta;
     unsigned int sweep_limit;
-    struct mov_avg_cma cma;
+    /* Latency of each operation, in nanoseconds. */
+    struct histogram latency[HEAP_N_OPS];
+    /* Hardware counters at the start and end of each phase. */
+    struct perf_sample perf[3];
+    /* Only measured when allocations are counted. */
+    struct test_memory memory;
 };
 
 #define TEST_RESULTS_INITIALIZER { \
     .t = { 0, 0, 0, }, \
     .delta = 0, .sweep_limit = 0, \
-    .cma = MOV_AVG_CMA_INITIALIZER, \
 }
 
 struct test {
@@ -56,4 +85,57 @@ struct test {
     .h = NULL, \
 }
 
+#define TEST_N_PERCENTILES 4
+
+extern const char *op_desc[HEAP_N_OPS];
+extern const double percentiles[TEST_N_PERCENTILES];
+
+/* Bytes per element used by the heap, for 'bytes' allocated. */
+double test_bytes_per_elem(struct test *t, long long int bytes);
+/* Run the test of 't' on its heap, filling its results. */
+void test_execute(struct test *t);
+/* Number of operations of phase 'i' in the last run of 't',
+ * 0 for the insertion and 1 for the removals. */
+unsigned long long int test_phase_ops(struct test *t, size_t i);
+/* Average time in nanoseconds of these operations. */
+double test_phase_ns(struct test *t, size_t i);
+
+/* Run the test of each heap on up to 'max_threads' threads, each with
+ * its own heap instance, pinned from 'first_cpu' onward if not -1. */
+void parallel_bench_run(struct test_params *params, struct heap **heaps,
+                        size_t n_heaps, unsigned int max_threads,
+                        unsigned int warmup, int first_cpu);
+
+/* Run the k-way merge benchmark over 'n_elems' elements. */
+void merge_bench_run(struct test_params *params);
+
+/* Run single-source shortest paths on the DIMACS graph in 'path',
+ * or on a road-like grid of 'n_elems' vertices if it does not exist. */
+void sssp_bench_run(struct test_params *params, const char *path);
+
+/* Priority queue workloads. */
+struct workload;
+
+struct workload_result {
+    /* Timer ticks. */
+    uint64_t start;
+    uint64_t end;
+    unsigned long long int n_ops;
+    /* Checksum of the output. */
+    unsigned long long int result;
+};
+
+/* Returns the workload named 'name', NULL if unknown. */
+const struct workload *workload_find(const char *name);
+/* Print the name and description of all workloads into 's'. */
+void workload_list(FILE *s);
+const char *workload_desc(const struct workload *w);
+/* Build the inputs of 'w' for all heaps. */
+void workload_init(const struct workload *w, struct test_params *params);
+/* Run 'w' against 'h'. Returns false if the heap does not
+ * support the operations of the workload. */
+bool workload_run(const struct workload *w, struct heap *h,
+                  struct workload_result *r);
+void workload_finish(const struct workload *w);
+
 #endif /* BENCH_H */
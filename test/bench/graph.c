@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#include "graph.h"
+
+void
+graph_build(struct graph *g, size_t n, const struct graph_arc *arcs,
+            size_t m, bool undirected)
+{
+    size_t *pos;
+    size_t i;
+
+    g->n = n;
+    g->m = undirected ? 2 * m : m;
+    g->first = xcalloc(n + 1, sizeof g->first[0]);
+    g->dst = xcalloc(MAX(g->m, 1), sizeof g->dst[0]);
+    g->weight = xcalloc(MAX(g->m, 1), sizeof g->weight[0]);
+    pos = xcalloc(MAX(n, 1), sizeof pos[0]);
+
+    for (i = 0; i < m; i++) {
+        g->first[arcs[i].u + 1]++;
+        if (undirected) {
+            g->first[arcs[i].v + 1]++;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        g->first[i + 1] += g->first[i];
+        pos[i] = g->first[i];
+    }
+    for (i = 0; i < m; i++) {
+        const struct graph_arc *a = &arcs[i];
+
+        g->dst[pos[a->u]] = a->v;
+        g->weight[pos[a->u]++] = a->w;
+        if (undirected) {
+            g->dst[pos[a->v]] = a->u;
+            g->weight[pos[a->v]++] = a->w;
+        }
+    }
+
+    free(pos);
+}
+
+/* Parse an unsigned integer followed by a blank or the end of line,
+ * moving 's' past it. */
+static bool
+dimacs_uint(char **s, uint32_t *v)
+{
+    unsigned long int x;
+    char *end;
+
+    errno = 0;
+    x = strtoul(*s, &end, 10);
+    if (end == *s || errno != 0 || x > UINT32_MAX ||
+        (*end != '\0' && *end != ' ' && *end != '\t' && *end != '\n')) {
+        return false;
+    }
+    *s = end;
+    *v = x;
+    return true;
+}
+
+static const char *
+dimacs_parse(FILE *f, struct graph *g)
+{
+    struct graph_arc *arcs = NULL;
+    size_t n = 0, m = 0, count = 0;
+    char line[256];
+
+    while (fgets(line, sizeof line, f) != NULL) {
+        char *s = line + 1;
+        struct graph_arc a;
+
+        if (line[0] == 'c' || line[0] == '\n') {
+            continue;
+        }
+        if (line[0] == 'p') {
+            if (arcs != NULL || sscanf(line, "p sp %zu %zu", &n, &m) != 2 ||
+                n == 0 || n > UINT32_MAX) {
+                free(arcs);
+                return "invalid problem line";
+            }
+            arcs = xcalloc(MAX(m, 1), sizeof arcs[0]);
+            continue;
+        }
+        if (line[0] != 'a' || arcs == NULL) {
+            free(arcs);
+            return "expected an arc after the problem line";
+        }
+        if (!dimacs_uint(&s, &a.u) || !dimacs_uint(&s, &a.v) ||
+            !dimacs_uint(&s, &a.w)) {
+            free(arcs);
+            return "invalid arc";
+        }
+        if (a.u == 0 || a.u > n || a.v == 0 || a.v > n) {
+            free(arcs);
+            return "arc vertex out of range";
+        }
+        if (count == m) {
+            free(arcs);
+            return "more arcs than announced";
+        }
+        a.u--;
+        a.v--;
+        arcs[count++] = a;
+    }
+
+    if (ferror(f)) {
+        free(arcs);
+        return strerror(errno);
+    }
+    if (arcs == NULL) {
+        return "no problem line";
+    }
+
+    graph_build(g, n, arcs, count, false);
+    free(arcs);
+    return NULL;
+}
+
+bool
+graph_load_dimacs(struct graph *g, const char *path, const char **err)
+{
+    FILE *f;
+
+    memset(g, 0, sizeof *g);
+    f = fopen(path, "r");
+    if (f == NULL) {
+        *err = strerror(errno);
+        return false;
+    }
+
+    *err = dimacs_parse(f, g);
+    fclose(f);
+    return *err == NULL;
+}
+
+/* Rows and columns of highways. */
+#define ROAD_HIGHWAY_EVERY 32
+
+void
+graph_road_grid(struct graph *g, size_t n)
+{
+    size_t side = MAX(ceil(sqrt(n)), 2);
+    struct graph_arc *arcs;
+    size_t x, y, m = 0;
+
+    arcs = xcalloc(2 * side * side, sizeof arcs[0]);
+    for (y = 0; y < side; y++) {
+        for (x = 0; x < side; x++) {
+            uint32_t u = y * side + x;
+
+            /* Streets are all kept, while avenues are sometimes
+             * missing outside of highways, which keep the grid
+             * connected. */
+            if (x + 1 < side) {
+                uint32_t w = (y % ROAD_HIGHWAY_EVERY == 0)
+                             ? 30 + random_u32_range(20)
+                             : 100 + random_u32_range(200);
+
+                arcs[m++] = (struct graph_arc) { u, u + 1, w };
+            }
+            if (y + 1 < side) {
+                if (x % ROAD_HIGHWAY_EVERY == 0) {
+                    arcs[m++] = (struct graph_arc) {
+                        u, u + side, 30 + random_u32_range(20),
+                    };
+                } else if (random_u32_range(4) != 0) {
+                    arcs[m++] = (struct graph_arc) {
+                        u, u + side, 100 + random_u32_range(200),
+                    };
+                }
+            }
+        }
+    }
+
+    graph_build(g, side * side, arcs, m, true);
+    free(arcs);
+}
+
+void
+graph_destroy(struct graph *g)
+{
+    free(g->first);
+    free(g->dst);
+    free(g->weight);
+    memset(g, 0, sizeof *g);
+}
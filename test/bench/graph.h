@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Weighted graphs for the search workloads.
+ *
+ * Graphs are kept in compressed sparse rows: the arcs leaving
+ * vertex 'u' are within [first[u], first[u + 1]) of 'dst' and 'weight'.
+ * Undirected edges are stored as two arcs.
+ *
+ * They can be read from the shortest path format of the 9th DIMACS
+ * implementation challenge ('.gr' files), whose vertices are numbered
+ * from 1: they are numbered from 0 once loaded.
+ */
+
+struct graph {
+    size_t n;
+    /* Number of arcs. */
+    size_t m;
+    size_t *first;
+    uint32_t *dst;
+    uint32_t *weight;
+};
+
+struct graph_arc {
+    uint32_t u;
+    uint32_t v;
+    uint32_t w;
+};
+
+/* Build 'g' over 'n' vertices from 'm' arcs, each one stored
+ * in both directions if 'undirected'. */
+void graph_build(struct graph *g, size_t n, const struct graph_arc *arcs,
+                 size_t m, bool undirected);
+/* Load a DIMACS '.gr' file. Returns false on failure,
+ * with 'err' describing it. */
+bool graph_load_dimacs(struct graph *g, const char *path, const char **err);
+/* Generate a road-like grid of at least 'n' vertices: local roads
+ * between neighbours, some of them missing, and faster highways
+ * every few rows and columns. Weights are travel times. */
+void graph_road_grid(struct graph *g, size_t n);
+void graph_destroy(struct graph *g);
+
+#endif /* GRAPH_H */
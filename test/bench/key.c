@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+
+#include "key.h"
+
+static const char *key_type_names[] = {
+    [ELEMENT_KEY_32] = "32",
+    [ELEMENT_KEY_64] = "64",
+    [ELEMENT_KEY_128] = "128",
+    [ELEMENT_KEY_STRING] = "string",
+};
+
+bool
+key_type_parse(const char *s, enum element_key_type *type)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(key_type_names); i++) {
+        if (!strcmp(s, key_type_names[i])) {
+            *type = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *
+key_type_name(enum element_key_type type)
+{
+    return key_type_names[type];
+}
+
+void
+key_set(struct element *e, long long int v)
+{
+    if (element_key_type != ELEMENT_KEY_STRING) {
+        return;
+    }
+    /* Flip the sign bit to keep negative priorities sorted. */
+    snprintf(e->name, KEY_NAME_LEN, "%020llu",
+             (unsigned long long int) v ^ (1ULL << 63));
+}
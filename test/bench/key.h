@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef KEY_H
+#define KEY_H
+
+#include <stdbool.h>
+
+#include "heap.h"
+
+/* Keys of the bench elements.
+ *
+ * Priorities are 64-bit integers compared at the lowest cost by default.
+ * With other key types, or an added cost, heaps compare whole keys
+ * instead, see 'element_key_type' in heap.h: composite keys are the
+ * priority followed by a hash of the element, like a deadline and
+ * a flow hash, and strings are names holding the priority in
+ * fixed-width decimal, sharing a prefix of zeros.
+ *
+ * The bench sets the key of an element when its priority changes,
+ * outside of timed operations.
+ */
+
+/* Room for the name of each element. */
+#define KEY_NAME_LEN 24
+
+/* Parse '32', '64', '128' or 'string'. */
+bool key_type_parse(const char *s, enum element_key_type *type);
+const char *key_type_name(enum element_key_type type);
+
+/* Whether heaps must compare whole keys. */
+static inline bool
+key_is_whole(void)
+{
+    return element_key_type != ELEMENT_KEY_64 || element_cmp_cost > 0;
+}
+
+/* Set the key of 'e' for priority 'v', before it is given to a heap. */
+void key_set(struct element *e, long long int v);
+
+#endif /* KEY_H */
@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#include "key.h"
+#include "layout.h"
+
+static const char *layout_names[] = {
+    [LAYOUT_CONTIGUOUS] = "contiguous",
+    [LAYOUT_SHUFFLED] = "shuffled",
+    [LAYOUT_MALLOC] = "malloc",
+    [LAYOUT_INTERLEAVED] = "interleaved",
+};
+
+bool
+layout_parse(const char *s, struct layout *l)
+{
+    size_t len = strcspn(s, ":");
+
+    for (size_t i = 0; i < ARRAY_SIZE(layout_names); i++) {
+        if (len != strlen(layout_names[i]) ||
+            strncmp(s, layout_names[i], len)) {
+            continue;
+        }
+        l->kind = i;
+        if (s[len] == '\0') {
+            return true;
+        }
+        if (l->kind != LAYOUT_INTERLEAVED) {
+            return false;
+        }
+        return str_to_uint(&s[len + 1], 10, &l->padding);
+    }
+    return false;
+}
+
+void
+layout_print(const struct layout *l)
+{
+    printf("Layout: ");
+    switch (l->kind) {
+    case LAYOUT_CONTIGUOUS:
+        printf("contiguous elements");
+        break;
+    case LAYOUT_SHUFFLED:
+        printf("elements shuffled within an arena");
+        break;
+    case LAYOUT_MALLOC:
+        printf("elements allocated one by one");
+        break;
+    case LAYOUT_INTERLEAVED:
+        printf("elements interleaved with %u bytes of cold padding",
+               l->padding);
+        break;
+    }
+    printf(", %zu bytes each.\n", sizeof(struct element));
+}
+
+/* Distance between elements within the arena. */
+static size_t
+layout_stride(const struct layout *l)
+{
+    size_t align = _Alignof(struct element);
+    size_t stride = sizeof(struct element);
+
+    if (l->kind == LAYOUT_INTERLEAVED) {
+        stride += (l->padding + align - 1) & ~(align - 1);
+    }
+    return stride;
+}
+
+/* Finalizer of splitmix64, standing for the hash of a flow. */
+static uint64_t
+element_hash(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static void
+element_set_keys(struct element_set *s)
+{
+    size_t i;
+
+    s->names = NULL;
+    if (element_key_type == ELEMENT_KEY_STRING) {
+        s->names = xzalloc(MAX(s->n, 1) * KEY_NAME_LEN);
+    }
+    for (i = 0; i < s->n; i++) {
+        if (s->names != NULL) {
+            s->e[i]->name = &s->names[i * KEY_NAME_LEN];
+        } else {
+            s->e[i]->hash = element_hash(i);
+        }
+    }
+}
+
+void
+element_set_alloc(struct element_set *s, const struct layout *l,
+                  struct placement *p, size_t n)
+{
+    size_t stride = layout_stride(l);
+    /* Fixed seed, for the same layout on each test. */
+    uint32_t rng = 1;
+    size_t i;
+
+    s->e = xmalloc(MAX(n, 1) * sizeof s->e[0]);
+    s->n = n;
+    s->arena = NULL;
+    s->arena_size = 0;
+
+    if (l->kind == LAYOUT_MALLOC) {
+        for (i = 0; i < n; i++) {
+            s->e[i] = xzalloc(sizeof *s->e[i]);
+            s->e[i]->id = i;
+        }
+        element_set_keys(s);
+        return;
+    }
+
+    s->arena_size = n * stride;
+    s->arena = placement_alloc(p, s->arena_size);
+    for (i = 0; i < n; i++) {
+        s->e[i] = (struct element *) ((char *) s->arena + i * stride);
+    }
+
+    if (l->kind == LAYOUT_SHUFFLED) {
+        /* Fisher-Yates. */
+        for (i = n; i > 1; i--) {
+            size_t j = xorshift32(&rng) % i;
+            struct element *tmp = s->e[i - 1];
+
+            s->e[i - 1] = s->e[j];
+            s->e[j] = tmp;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        s->e[i]->id = i;
+    }
+    element_set_keys(s);
+}
+
+void
+element_set_free(struct element_set *s, const struct layout *l,
+                 struct placement *p)
+{
+    if (l->kind == LAYOUT_MALLOC) {
+        for (size_t i = 0; i < s->n; i++) {
+            free(s->e[i]);
+        }
+    } else {
+        placement_free(p, s->arena, s->arena_size);
+    }
+    free(s->names);
+    free(s->e);
+    s->e = NULL;
+    s->names = NULL;
+    s->n = 0;
+}
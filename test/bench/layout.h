@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "heap.h"
+#include "placement.h"
+
+/* Layout of the elements of a test in memory.
+ *
+ * Elements are contiguous by default, each on its own cache line,
+ * which gives intrusive heaps a locality they would not find among
+ * objects spread over a fragmented heap. Other layouts scatter them:
+ *
+ *  - shuffled: slots of a single arena, in a random order,
+ *  - malloc: allocated one by one,
+ *  - interleaved: each followed by a cold object of 'padding' bytes,
+ *    never accessed, misaligning elements unless a multiple of 64.
+ *
+ * Elements are reached through an array of pointers whatever the
+ * layout, so that the driving loop costs the same. The shuffle uses
+ * its own generator: the random sequence of the bench is untouched
+ * and all layouts draw the same priorities.
+ */
+
+enum layout_kind {
+    LAYOUT_CONTIGUOUS,
+    LAYOUT_SHUFFLED,
+    LAYOUT_MALLOC,
+    LAYOUT_INTERLEAVED,
+};
+
+struct layout {
+    enum layout_kind kind;
+    /* Bytes of cold padding after each element, when interleaved. */
+    unsigned int padding;
+};
+
+#define LAYOUT_DEFAULT_PADDING 256
+
+#define LAYOUT_INITIALIZER { \
+    .kind = LAYOUT_CONTIGUOUS, \
+    .padding = LAYOUT_DEFAULT_PADDING, \
+}
+
+struct element_set {
+    struct element **e;
+    size_t n;
+    /* Memory holding the elements, unless allocated one by one. */
+    void *arena;
+    size_t arena_size;
+    /* Storage of string keys, see key.h. */
+    char *names;
+};
+
+/* Parse 'contiguous', 'shuffled', 'malloc' or 'interleaved[:<bytes>]'. */
+bool layout_parse(const char *s, struct layout *l);
+/* Print the layout in use, on a single line. */
+void layout_print(const struct layout *l);
+
+/* Allocate 'n' zeroed elements laid out as 'l', arenas being
+ * placed according to 'p'. Elements are given their index as 'id'
+ * and the rest of their key, whose type must be set already. */
+void element_set_alloc(struct element_set *s, const struct layout *l,
+                       struct placement *p, size_t n);
+void element_set_free(struct element_set *s, const struct layout *l,
+                      struct placement *p);
+
+#endif /* LAYOUT_H */
@@ -4,15 +4,23 @@
 
 #define _GNU_SOURCE
 
+#include <errno.h>
 #include <limits.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
-#include "mov-avg.h"
 #include "util.h"
 #include "heap.h"
+#include "timer.h"
 
 #include "bench.h"
+#include "key.h"
+#include "layout.h"
+#include "placement.h"
+#include "stats.h"
+#include "sweep.h"
+#include "trace.h"
 
 static struct test_params params = {
     .name = NULL,
@@ -20,6 +28,93 @@ static struct test_params params = {
     .range = 24 * 60 * 60 * 1000,
     .seed = 0,
     .p_update = 0,
+    .p_shed = 0,
+};
+
+/* Comma-separated list of heap names to run, all if NULL. */
+static const char *heap_selection;
+
+static bool run_merge;
+
+/* Run shortest paths on this DIMACS graph instead of a sweep. */
+static const char *sssp_path;
+
+/* Run this workload against each heap instead of a sweep. */
+static const char *workload_name;
+
+/* Read the time stamp counter if usable. */
+static bool use_tsc = true;
+
+/* Read hardware counters around each phase. */
+static bool use_perf;
+
+/* Count allocations and measure the memory used by heaps. */
+static bool use_memory;
+
+/* Only run with this percentage of updates, if set. */
+static bool fixed_update;
+
+/* Record the operations of the first test into this file. */
+static const char *record_path;
+static struct trace_writer *recording;
+
+/* Replay the operations of this trace instead of a sweep. */
+static const char *replay_path;
+
+/* Write all metrics over the given ranges of parameters, if set. */
+static bool run_sweep;
+static struct sweep sweep = {
+    .format = SWEEP_CSV,
+    .repeat = 1,
+};
+
+/* Runs of each test before measuring it. */
+static unsigned int warmup;
+
+/* Save the measures of each test into this file. */
+static const char *save_path;
+static FILE *save_file;
+
+/* Compare the measures of each test against this baseline. */
+static const char *baseline_path;
+static struct baseline baseline;
+static unsigned int n_regressions;
+
+/* Comparisons need a few measures on both sides,
+ * and ignore changes within the noise. */
+#define BASELINE_MIN_SAMPLES 5
+#define BASELINE_NOISE 0.02
+
+/* CPU, memory node and pages used by the bench. */
+static struct placement placement = PLACEMENT_INITIALIZER;
+
+/* Layout of the elements in memory. */
+static struct layout layout = LAYOUT_INITIALIZER;
+
+/* Run each test on up to this many threads at once, if set. */
+static unsigned int n_threads;
+
+/* Run the counted heaps, reporting the work done by operation. */
+static bool run_counted;
+
+static struct heap *heaps[] = {
+    &min_pairing_heap,
+    &min_fibonacci_heap,
+    &min_binary_heap,
+    &min_paged_binary_heap,
+    &min_calendar_queue,
+    &min_minmax_heap,
+    &min_sequence_heap,
+};
+
+static struct heap *counted_heaps[] = {
+    &min_pairing_heap_counted,
+    &min_fibonacci_heap_counted,
+    &min_binary_heap_counted,
+    &min_paged_binary_heap_counted,
+    &min_calendar_queue_counted,
+    &min_minmax_heap_counted,
+    &min_sequence_heap_counted,
 };
 
 static void
@@ -27,7 +122,7 @@ usage(const char *program_name, int error)
 {
     FILE *s = error ? stderr : stdout;
 
-    fprintf(s, "Usage: %s [-hnrs]\n", program_name);
+    fprintf(s, "Usage: %s [-bBcChDHKkLlMmNnPpQRrSTsuWwx]\n", program_name);
     fprintf(s, "\n");
     fprintf(s, "Run performance tests on heap operations using different implementations,\n");
     fprintf(s, "against the pairing heap reference.\n");
@@ -35,6 +130,57 @@ usage(const char *program_name, int error)
     fprintf(s, "-n <uint>:   Number of elements to sift through [n=%u].\n", params.n_elems);
     fprintf(s, "-r <uint>:   Range of elements priorities [r=%u].\n", params.range);
     fprintf(s, "-s <uint>:   Use given seed [s=%u].\n", params.seed);
+    fprintf(s, "-u <uint>:   Only run with this percentage of key updates.\n");
+    fprintf(s, "-S <fmt>:    Sweep over ranges of -n, -r and -u, writing all metrics\n");
+    fprintf(s, "             as 'csv' or 'json'. Ranges are comma-separated values\n");
+    fprintf(s, "             or 'a:b', doubling from a to b, 'a:b:xK' or 'a:b:+K',\n");
+    fprintf(s, "             e.g. -n 1000:1000000:x10 -u 0,10,30 [u=0,10,30].\n");
+    fprintf(s, "-k <uint>:   Repetitions of each test, reporting the median time\n");
+    fprintf(s, "             of each phase with its confidence interval [k=%u].\n",
+            sweep.repeat);
+    fprintf(s, "             Sweeps write each one, with successive seeds.\n");
+    fprintf(s, "-x <uint>:   Runs of each test before measuring it [x=%u].\n",
+            warmup);
+    fprintf(s, "-b <file>:   Save the measures of each test as a baseline.\n");
+    fprintf(s, "-B <file>:   Compare each test against a baseline, flagging\n");
+    fprintf(s, "             significant regressions. Needs -k %u or more.\n",
+            BASELINE_MIN_SAMPLES);
+    fprintf(s, "-H <list>:   Only run heaps whose name contains one of the\n");
+    fprintf(s, "             comma-separated words, e.g. 'pairing,binary'.\n");
+    fprintf(s, "-c           Count the work done by each type of operation:\n");
+    fprintf(s, "             comparisons, links, dereferences and allocations.\n");
+    fprintf(s, "             Heaps are slower when counting, times are not comparable.\n");
+    fprintf(s, "-C           Time operations with clock_gettime instead of\n");
+    fprintf(s, "             the time stamp counter.\n");
+    fprintf(s, "-P           Read hardware performance counters during each\n");
+    fprintf(s, "             phase, reported by operation.\n");
+    fprintf(s, "-M           Measure the memory used by heaps, counting their\n");
+    fprintf(s, "             allocations and the resident set size.\n");
+    fprintf(s, "-T <uint>:   Run the test of each heap on 1 up to this many threads,\n");
+    fprintf(s, "             doubling, each with its own heap. With -p, threads\n");
+    fprintf(s, "             are pinned to successive CPUs.\n");
+    fprintf(s, "-K <type>:   Order elements by '32' bits keys, '64' bits, '128' bits\n");
+    fprintf(s, "             composite keys or 'string' keys [K=64]. Heaps\n");
+    fprintf(s, "             ordering integer priorities only are skipped.\n");
+    fprintf(s, "-Q <uint>:   Spin this many iterations on each comparison [Q=0].\n");
+    fprintf(s, "-l <layout>: Lay elements out as 'contiguous', 'shuffled' slots\n");
+    fprintf(s, "             of an arena, allocated one by one with 'malloc', or\n");
+    fprintf(s, "             'interleaved[:<bytes>]' with cold padding objects\n");
+    fprintf(s, "             [l=contiguous, padding=%u].\n", LAYOUT_DEFAULT_PADDING);
+    fprintf(s, "-p <cpu>:    Pin the bench to this CPU.\n");
+    fprintf(s, "-N <node>:   Bind the memory of the bench to this NUMA node.\n");
+    fprintf(s, "-L <pages>:  Back elements and heap storage with 'thp', transparent\n");
+    fprintf(s, "             huge pages, or 'hugetlb', explicit ones [L=none].\n");
+    fprintf(s, "-w <file>:   Record the operations of the first test into a trace,\n");
+    fprintf(s, "             select it with -H and -u.\n");
+    fprintf(s, "-R <file>:   Replay the operations of a trace against each heap.\n");
+    fprintf(s, "-W <name>:   Run a workload against each heap instead, 'list' to\n");
+    fprintf(s, "             show them. Priorities are not bounded by the range.\n");
+    fprintf(s, "-D <file>:   Run shortest paths on a DIMACS '.gr' graph instead,\n");
+    fprintf(s, "             using the key decrease of each heap. A road-like\n");
+    fprintf(s, "             grid of n vertices is generated if it does not exist.\n");
+    fprintf(s, "-m           Run the k-way merge benchmark instead, comparing the\n");
+    fprintf(s, "             tournament tree against heaps for k from 2 to 4096.\n");
     fprintf(s, "-h           Show this help.\n");
 
     exit(error);
@@ -43,21 +189,50 @@ usage(const char *program_name, int error)
 static int
 parse_params(int argc, char * const argv[], struct test_params *params)
 {
+    unsigned int uint;
     int opt;
 
-    while ((opt = getopt(argc, argv, "hn:r:s:")) != -1) {
+    while ((opt = getopt(argc, argv, "b:B:cChD:H:K:k:L:l:MmN:n:Pp:Q:R:r:S:s:T:u:W:w:x:")) != -1) {
         switch (opt) {
         case 'n':
-            if (!str_to_uint(optarg, 10, &params->n_elems)) {
-               fprintf(stderr, "Failed to parse uint: '%s'\n", optarg);
+            if (!sweep_values_parse(optarg, &sweep.n_elems)) {
+               fprintf(stderr, "Failed to parse values: '%s'\n", optarg);
                return -1;
             }
+            params->n_elems = sweep.n_elems.v[0];
             break;
         case 'r':
-            if (!str_to_uint(optarg, 10, &params->range)) {
+            if (!sweep_values_parse(optarg, &sweep.range)) {
+               fprintf(stderr, "Failed to parse values: '%s'\n", optarg);
+               return -1;
+            }
+            params->range = sweep.range.v[0];
+            break;
+        case 'k':
+            if (!str_to_uint(optarg, 10, &sweep.repeat) || sweep.repeat == 0) {
+               fprintf(stderr, "Invalid repetition count: '%s'\n", optarg);
+               return -1;
+            }
+            break;
+        case 'x':
+            if (!str_to_uint(optarg, 10, &warmup)) {
                fprintf(stderr, "Failed to parse uint: '%s'\n", optarg);
                return -1;
             }
+            sweep.warmup = warmup;
+            break;
+        case 'b':
+            save_path = optarg;
+            break;
+        case 'B':
+            baseline_path = optarg;
+            break;
+        case 'S':
+            if (!sweep_format_parse(optarg, &sweep.format)) {
+               fprintf(stderr, "Unknown format: '%s'\n", optarg);
+               return -1;
+            }
+            run_sweep = true;
             break;
         case 's':
             if (!str_to_uint(optarg, 10, &params->seed)) {
@@ -65,6 +240,90 @@ parse_params(int argc, char * const argv[], struct test_params *params)
                return -1;
             }
             break;
+        case 'c':
+            run_counted = true;
+            break;
+        case 'C':
+            use_tsc = false;
+            break;
+        case 'P':
+            use_perf = true;
+            break;
+        case 'M':
+            use_memory = true;
+            break;
+        case 'u':
+            if (!sweep_values_parse(optarg, &sweep.p_update)) {
+               fprintf(stderr, "Invalid percentage: '%s'\n", optarg);
+               return -1;
+            }
+            for (size_t i = 0; i < sweep.p_update.n; i++) {
+                if (sweep.p_update.v[i] > 100) {
+                   fprintf(stderr, "Invalid percentage: '%s'\n", optarg);
+                   return -1;
+                }
+            }
+            params->p_update = sweep.p_update.v[0];
+            fixed_update = true;
+            break;
+        case 'W':
+            workload_name = optarg;
+            break;
+        case 'w':
+            record_path = optarg;
+            break;
+        case 'R':
+            replay_path = optarg;
+            break;
+        case 'D':
+            sssp_path = optarg;
+            break;
+        case 'H':
+            heap_selection = optarg;
+            break;
+        case 'm':
+            run_merge = true;
+            break;
+        case 'p':
+        case 'N':
+            if (!str_to_uint(optarg, 10, &uint) || uint > INT_MAX) {
+               fprintf(stderr, "Failed to parse uint: '%s'\n", optarg);
+               return -1;
+            }
+            *(opt == 'p' ? &placement.cpu : &placement.node) = uint;
+            break;
+        case 'T':
+            if (!str_to_uint(optarg, 10, &n_threads) || n_threads == 0) {
+               fprintf(stderr, "Invalid thread count: '%s'\n", optarg);
+               return -1;
+            }
+            break;
+        case 'K':
+            if (!key_type_parse(optarg, &element_key_type)) {
+               fprintf(stderr, "Unknown key type '%s', expected"
+                       " '32', '64', '128' or 'string'\n", optarg);
+               return -1;
+            }
+            break;
+        case 'Q':
+            if (!str_to_uint(optarg, 10, &element_cmp_cost)) {
+               fprintf(stderr, "Failed to parse uint: '%s'\n", optarg);
+               return -1;
+            }
+            break;
+        case 'l':
+            if (!layout_parse(optarg, &layout)) {
+               fprintf(stderr, "Unknown layout '%s'\n", optarg);
+               return -1;
+            }
+            break;
+        case 'L':
+            if (!placement_pages_parse(optarg, &placement.pages)) {
+               fprintf(stderr, "Unknown pages '%s', expected"
+                       " 'none', 'thp' or 'hugetlb'\n", optarg);
+               return -1;
+            }
+            break;
         case 'h':
             usage(argv[0], 0);
             break;
@@ -74,10 +333,39 @@ parse_params(int argc, char * const argv[], struct test_params *params)
         }
     }
 
+    if (!run_sweep && (sweep.n_elems.n > 1 || sweep.range.n > 1 ||
+                       sweep.p_update.n > 1)) {
+        fprintf(stderr, "Ranges of values are only used by sweeps, see -S.\n");
+        return -1;
+    }
+
+    if (n_threads > 0 && (run_sweep || run_merge || sssp_path ||
+                          workload_name || replay_path || record_path)) {
+        fprintf(stderr, "Threads only apply to the default tests.\n");
+        return -1;
+    }
+
+    if (key_is_whole() && (run_merge || sssp_path || workload_name)) {
+        fprintf(stderr, "Key types and costs do not apply to -m, -D or -W.\n");
+        return -1;
+    }
+    /* Updated elements reach twice the range ahead of the oldest. */
+    for (size_t i = 0; element_key_type == ELEMENT_KEY_32 &&
+                       i < MAX(sweep.range.n, 1); i++) {
+        unsigned int range = sweep.range.n ? sweep.range.v[i] : params->range;
+
+        if (range >= 1u << 30) {
+            fprintf(stderr, "32 bits keys wrap around, ranges must be"
+                    " below 2^30.\n");
+            return -1;
+        }
+    }
+
    return 0;
 }
 
-static long long int time_delta;
+/* Each thread runs its own fake clock. */
+static _Thread_local long long int time_delta;
 static long long int
 clock_read(void)
 {
@@ -99,17 +387,174 @@ clock_drift(long long int delta)
     }
 }
 
-#define NAME_LEN 18
+/* Mark the boundary 'i' of the test phases, 0 being their start.
+ * Counters are read outside of the timed phases. */
+static void
+test_memory_read(struct test_memory *m, size_t i)
+{
+    if (i == 0) {
+        m->base = alloc_stats;
+        m->rss_base = alloc_rss();
+        alloc_peak_reset();
+        return;
+    }
+
+    if (i == 1) {
+        m->live = alloc_stats.live - m->base.live;
+    }
+    m->rss[i - 1] = alloc_rss() - m->rss_base;
+    m->peak = alloc_stats.peak - m->base.live;
+    m->n_allocs = alloc_stats.n_allocs - m->base.n_allocs;
+    m->bytes = alloc_stats.bytes - m->base.bytes;
+}
+
+static void
+test_phase(struct test_results *r, size_t i)
+{
+    if (i == 0) {
+        if (use_memory) {
+            test_memory_read(&r->memory, i);
+        }
+        if (use_perf) {
+            perf_read(&r->perf[i]);
+        }
+        r->t[i] = timer_start();
+    } else {
+        r->t[i] = timer_stop();
+        if (use_perf) {
+            perf_read(&r->perf[i]);
+        }
+        if (use_memory) {
+            test_memory_read(&r->memory, i);
+        }
+    }
+}
+
+static void
+test_record(struct test_results *r, enum heap_op op, uint64_t start)
+{
+    histogram_add(&r->latency[op], timer_ns(start, timer_stop()));
+}
+
+#define NAME_LEN 24
+
+const char *op_desc[HEAP_N_OPS] = {
+    [HEAP_OP_INSERT] = "insert",
+    [HEAP_OP_POP] = "pop",
+    [HEAP_OP_UPDATE] = "update",
+};
+
+const double percentiles[TEST_N_PERCENTILES] = { 50, 90, 99, 99.9, };
 
 static void
 test_column_print(void)
 {
-    printf("%*s (P-u%%): %*s %*s %*s%*s (ms)\n",
+    printf("Timer: %s, %.3f ticks/ns, overhead of %llu ticks "
+           "subtracted from measures.\n", timer.source, timer.freq,
+           (unsigned long long int) timer.overhead);
+    printf("%*s (P-u%%): %*s %*s (ns/op) %*s %*s %*s %*s %*s %*s (ns)\n",
             NAME_LEN, "Queue type",
             10, "insert",
             10, "delete",
-            5, " ",
-            10, "sweep-avg(stdev)");
+            6, "op",
+            8, "p50",
+            8, "p90",
+            8, "p99",
+            8, "p99.9",
+            8, "max");
+}
+
+static void
+test_counts_print(struct heap *h)
+{
+    size_t i;
+
+    for (i = 0; i < HEAP_N_OPS; i++) {
+        struct heap_counts *c = &h->counts[i];
+        double ops = c->ops;
+
+        if (c->ops == 0) {
+            continue;
+        }
+        printf("%*s %-6s: %10llu ops, %6.2lf cmp, %6.2lf link,"
+               " %6.2lf deref, %6.4lf alloc /op\n",
+               NAME_LEN + 7, " ", op_desc[i], c->ops,
+               c->cmp / ops, c->link / ops,
+               c->deref / ops, c->alloc / ops);
+    }
+}
+
+static void
+test_perf_print(struct test_results *r, const char *phase, size_t i,
+                unsigned long long int n)
+{
+    const char *sep = "";
+    struct perf_sample d;
+
+    if (n == 0) {
+        return;
+    }
+
+    perf_diff(&r->perf[i], &r->perf[i + 1], &d);
+    printf("%*s %-6s:", NAME_LEN + 7, " ", phase);
+    for (size_t j = 0; j < PERF_N_EVENTS; j++) {
+        if (d.valid[j]) {
+            printf("%s %.*lf %s", sep, j <= PERF_INSTRUCTIONS ? 1 : 3,
+                   d.v[j] / n, perf_event_desc[j]);
+            sep = ",";
+        }
+    }
+    printf(" /op");
+    if (d.valid[PERF_CYCLES] && d.valid[PERF_INSTRUCTIONS] &&
+        d.v[PERF_CYCLES] > 0) {
+        printf(", %.2lf IPC", d.v[PERF_INSTRUCTIONS] / d.v[PERF_CYCLES]);
+    }
+    printf("\n");
+}
+
+double
+test_bytes_per_elem(struct test *t, long long int bytes)
+{
+    unsigned int n = MAX(t->params.n_elems, 1);
+
+    return (double) bytes / n + t->h->node_size;
+}
+
+static void
+test_memory_print(struct test *t)
+{
+    struct test_memory *m = &t->results.memory;
+
+    printf("%*s memory: %.1lf B/elem, %.1lf B/elem at peak,"
+           " %llu allocs of %.1lf kB, RSS %+.1lf kB inserted,"
+           " %+.1lf kB at end\n", NAME_LEN + 7, " ",
+           test_bytes_per_elem(t, m->live), test_bytes_per_elem(t, m->peak),
+           m->n_allocs, m->bytes / 1024., m->rss[0] / 1024.,
+           m->rss[1] / 1024.);
+}
+
+unsigned long long int
+test_phase_ops(struct test *t, size_t i)
+{
+    unsigned long long int n_ops = 0;
+
+    for (size_t j = 0; j < HEAP_N_OPS; j++) {
+        n_ops += t->results.latency[j].count;
+    }
+    return i == 0 ? t->params.n_elems : n_ops - t->params.n_elems;
+}
+
+/* Each operation of a phase having been timed,
+ * the overhead of the timer is removed. */
+double
+test_phase_ns(struct test *t, size_t i)
+{
+    struct test_results *r = &t->results;
+    unsigned long long int n = test_phase_ops(t, i);
+    double ticks = (double) (r->t[i + 1] - r->t[i]) -
+                   (double) n * timer.overhead;
+
+    return n == 0 || ticks < 0 ? 0 : ticks / timer.freq / n;
 }
 
 static void
@@ -117,25 +562,69 @@ test_print(struct test *t)
 {
     struct test_results *r = &t->results;
     struct test_params *p = &t->params;
+    bool first = true;
+    char name[64];
 
-    printf("%*s (%03u%%):", NAME_LEN, t->h->desc, p->p_update);
-    printf(" %10lld", r->times.insertion - r->times.start);
-    printf(" %10lld", r->times.end - r->times.insertion);
-    printf("%*s", 5, " ");
-    printf(" %9.1lf(%.1lf)", mov_avg_cma(&r->cma),
-                             mov_avg_cma_std_dev(&r->cma));
-    printf("\n");
+    if (p->p_shed) {
+        snprintf(name, sizeof name, "%s/shed-%u%%", t->h->desc, p->p_shed);
+    } else {
+        snprintf(name, sizeof name, "%s", t->h->desc);
+    }
+
+    printf("%*s (%03u%%):", NAME_LEN, name, p->p_update);
+    printf(" %10.1lf", test_phase_ns(t, 0));
+    printf(" %10.1lf", test_phase_ns(t, 1));
+    printf("%*s", 8, " ");
+
+    /* One line per operation, the first one following the totals. */
+    for (size_t i = 0; i < HEAP_N_OPS; i++) {
+        struct histogram *l = &r->latency[i];
+
+        if (l->count == 0) {
+            continue;
+        }
+        if (!first) {
+            printf("%*s", NAME_LEN + 38, " ");
+        }
+        printf(" %*s", 6, op_desc[i]);
+        for (size_t j = 0; j < ARRAY_SIZE(percentiles); j++) {
+            printf(" %8llu", histogram_percentile(l, percentiles[j]));
+        }
+        printf(" %8llu\n", l->max);
+        first = false;
+    }
+
+    if (t->h->counts != NULL) {
+        test_counts_print(t->h);
+    }
+    if (use_perf) {
+        test_perf_print(r, "insert", 0, test_phase_ops(t, 0));
+        test_perf_print(r, "delete", 1, test_phase_ops(t, 1));
+    }
+    if (use_memory) {
+        test_memory_print(t);
+    }
 }
 
 static void
+test_trace(enum trace_op_type type, struct element *e, long long int key)
+{
+    if (recording != NULL) {
+        trace_write(recording, type, e->id, key);
+    }
+}
+
+void
 test_execute(struct test *t)
 {
     struct test_results *r = &t->results;
     struct test_params *p = &t->params;
     long long int now = clock_read();
     struct heap *h = t->h;
-    struct element *elems;
+    struct element_set set;
+    struct element **elems;
     long long int delta;
+    uint64_t start;
     unsigned int limit;
     unsigned int i;
 
@@ -144,41 +633,72 @@ test_execute(struct test *t)
     limit = MAX(100, p->n_elems / 10);
     delta = MAX(1, p->range / 10);
 
-    elems = xcalloc(p->n_elems, sizeof elems[0]);
+    element_set_alloc(&set, &layout, &placement, p->n_elems);
+    elems = set.e;
 
     r->delta = delta;
     r->sweep_limit = limit;
+    for (i = 0; i < HEAP_N_OPS; i++) {
+        histogram_init(&r->latency[i]);
+    }
     for (i = 0; i < p->n_elems; i++) {
-        elems[i].expiration = now + random_u32_range(p->range);
+        elems[i]->expiration = now + random_u32_range(p->range);
+        key_set(elems[i], elems[i]->expiration);
     }
 
-    heap_init(h);
+    if (key_is_whole()) {
+        heap_init_keys(h);
+    } else {
+        heap_init(h);
+    }
+    heap_op_counts_reset(h);
 
     /* Test results are not using the fake internal time, but actual
      * monotonic clock. */
-    r->times.start = time_msec();
+    test_phase(r, 0);
     for (i = 0; i < p->n_elems; i++) {
-        heap_insert(h, &elems[i]);
-        elems[i].inserted = true;
+        start = timer_start();
+        heap_insert(h, elems[i]);
+        test_record(r, HEAP_OP_INSERT, start);
+        test_trace(TRACE_INSERT, elems[i], elems[i]->expiration);
+        elems[i]->inserted = true;
     }
 
-    r->times.insertion = time_msec();
+    test_phase(r, 1);
     while (!heap_is_empty(h)) {
-        long long int sweep_start_ms;
         unsigned int count = 0;
         struct element *e;
 
-        sweep_start_ms = time_msec();
         while (count < limit) {
+            /* Shed load from the other end, dropping the
+             * element with the furthest expiration. */
+            if (p->p_shed && random_u32_range(100) < p->p_shed) {
+                start = timer_start();
+                e = heap_pop_max(h);
+                test_record(r, HEAP_OP_POP, start);
+                if (e == NULL) {
+                    break;
+                }
+                test_trace(TRACE_POP_MAX, e, e->expiration);
+                count++;
+                continue;
+            }
+            start = timer_start();
             e = heap_pop(h);
+            test_record(r, HEAP_OP_POP, start);
             if (e == NULL) {
                 break;
             }
+            test_trace(TRACE_POP, e, e->expiration);
             /* Half of random updates happening on oldest element,
              * other half within the heap at any point. */
             if (random_u32_range(100) < (p->p_update / 2)) {
                 e->expiration += p->range;
+                key_set(e, e->expiration);
+                start = timer_start();
                 heap_insert(h, e);
+                test_record(r, HEAP_OP_INSERT, start);
+                test_trace(TRACE_INSERT, e, e->expiration);
             } else {
                 while (e->expiration > clock_read()) {
                     clock_drift(delta);
@@ -188,20 +708,120 @@ test_execute(struct test *t)
         }
         /* Re-assign the other half of the random update. */
         for (i = 0; i < p->n_elems; i++) {
-            if (elems[i].inserted &&
+            if (elems[i]->inserted &&
                 random_u32_range(100) < (p->p_update / 2)) {
-                heap_update_key(h, &elems[i],
-                                elems[i].expiration + p->range);
+                key_set(elems[i], elems[i]->expiration + p->range);
+                start = timer_start();
+                heap_update_key(h, elems[i],
+                                elems[i]->expiration + p->range);
+                test_record(r, HEAP_OP_UPDATE, start);
+                test_trace(TRACE_UPDATE, elems[i], elems[i]->expiration);
             }
         }
-        mov_avg_cma_update(&r->cma, time_msec() - sweep_start_ms);
     }
-    r->times.end = time_msec();
+    test_phase(r, 2);
 
-    free(elems);
+    element_set_free(&set, &layout, &placement);
     return;
 }
 
+static void
+test_stats_print(struct test *t, const char *phase, struct samples *s)
+{
+    struct test_params *p = &t->params;
+    struct samples_summary sum;
+    struct samples *base;
+    double ratio, lo, hi;
+    char key[128];
+    bool change;
+
+    snprintf(key, sizeof key, "%s:n=%u:r=%u:u=%u:shed=%u:%s",
+             t->h->desc, p->n_elems, p->range, p->p_update, p->p_shed,
+             phase);
+    /* Keep the keys of default tests unchanged. */
+    if (key_is_whole()) {
+        size_t len = strlen(key);
+
+        snprintf(&key[len], sizeof key - len, ":key=%s:cost=%u",
+                 key_type_name(element_key_type), element_cmp_cost);
+    }
+    if (save_file != NULL) {
+        baseline_write(save_file, key, s);
+    }
+
+    samples_summarize(s, &sum);
+    printf("%*s %-6s: median %.1lf ns/op [%.1lf, %.1lf], mean %.1lf"
+           " +- %.1lf, %zu/%zu outliers\n", NAME_LEN + 7, " ",
+           phase, sum.median, sum.lo, sum.hi, sum.mean, sum.std_dev,
+           sum.n_outliers, s->n);
+
+    base = baseline_path != NULL ? baseline_find(&baseline, key) : NULL;
+    if (base == NULL) {
+        return;
+    }
+    change = samples_compare(base, s, BASELINE_NOISE, &ratio, &lo, &hi);
+    printf("%*s %-6s: %+.1lf%% [%+.1lf%%, %+.1lf%%] against the baseline",
+           NAME_LEN + 7, " ", phase, (ratio - 1) * 100,
+           (lo - 1) * 100, (hi - 1) * 100);
+    if (base->n < BASELINE_MIN_SAMPLES || s->n < BASELINE_MIN_SAMPLES) {
+        printf(", too few measures\n");
+    } else if (change && ratio > 1) {
+        printf(", REGRESSION\n");
+        n_regressions++;
+    } else if (change) {
+        printf(", improvement\n");
+    } else {
+        printf("\n");
+    }
+}
+
+static void
+test_run_one(struct test *t)
+{
+    struct samples phases[2] = { SAMPLES_INITIALIZER, SAMPLES_INITIALIZER, };
+    struct trace_writer w;
+    unsigned int i;
+
+    if (record_path != NULL) {
+        if (!trace_writer_open(&w, record_path, t->params.n_elems,
+                               t->params.p_update, t->params.p_shed)) {
+            fprintf(stderr, "Cannot record into '%s': %s\n",
+                    record_path, strerror(errno));
+            exit(1);
+        }
+        recording = &w;
+    }
+
+    for (i = 0; i < warmup + sweep.repeat; i++) {
+        test_execute(t);
+
+        if (recording != NULL) {
+            if (!trace_writer_close(&w)) {
+                fprintf(stderr, "Failed to write '%s'\n", record_path);
+                exit(1);
+            }
+            /* Only the first test is recorded. */
+            recording = NULL;
+            record_path = NULL;
+        }
+
+        if (i >= warmup) {
+            samples_add(&phases[0], test_phase_ns(t, 0));
+            samples_add(&phases[1], test_phase_ns(t, 1));
+        }
+    }
+
+    /* The details are given for the last run. */
+    test_print(t);
+    if (sweep.repeat > 1 || save_file != NULL || baseline_path != NULL) {
+        test_stats_print(t, "insert", &phases[0]);
+        test_stats_print(t, "delete", &phases[1]);
+    }
+
+    samples_destroy(&phases[0]);
+    samples_destroy(&phases[1]);
+}
+
 void
 test_run(struct heap *h)
 {
@@ -210,34 +830,425 @@ test_run(struct heap *h)
     t.params = (struct test_params) params;
     t.h = h;
 
+    if (fixed_update) {
+        if (h->update != NULL || t.params.p_update == 0) {
+            test_run_one(&t);
+        }
+        return;
+    }
+
     t.params.p_update = 0;
-    test_execute(&t);
-    test_print(&t);
+    test_run_one(&t);
+
+    if (h->update == NULL) {
+        return;
+    }
 
     t.params.p_update = 10;
-    test_execute(&t);
-    test_print(&t);
+    test_run_one(&t);
 
     t.params.p_update = 30;
-    test_execute(&t);
+    test_run_one(&t);
+
+    if (h->pop_max != NULL) {
+        t.params.p_update = 10;
+        t.params.p_shed = 10;
+        test_run_one(&t);
+    }
+}
+
+static void
+test_replay(struct test *t, struct trace *trace)
+{
+    struct test_results *r = &t->results;
+    struct test_params *p = &t->params;
+    struct element_set set;
+    struct heap *h = t->h;
+    uint64_t n_inserts = 0;
+    uint64_t start;
+    size_t i;
+
+    element_set_alloc(&set, &layout, &placement, trace->hdr->n_elems);
+    for (i = 0; i < HEAP_N_OPS; i++) {
+        histogram_init(&r->latency[i]);
+    }
+
+    if (key_is_whole()) {
+        heap_init_keys(h);
+    } else {
+        heap_init(h);
+    }
+    heap_op_counts_reset(h);
+
+    test_phase(r, 0);
+    r->times.insertion = 0;
+    for (i = 0; i < trace->hdr->n_ops; i++) {
+        struct trace_op *op = &trace->ops[i];
+        struct element *e = set.e[op->id];
+        enum trace_op_type type = op->type;
+
+        /* The first phase lasts until the first removal. */
+        if (r->times.insertion == 0 && type != TRACE_INSERT) {
+            test_phase(r, 1);
+            n_inserts = i;
+        }
+
+        /* On ties, this heap may have removed another element
+         * than the recorded one, keep the heap consistent. */
+        if (type == TRACE_INSERT && e->inserted) {
+            type = TRACE_UPDATE;
+        } else if (type == TRACE_UPDATE && !e->inserted) {
+            type = TRACE_INSERT;
+        }
+
+        switch (type) {
+        case TRACE_INSERT:
+            e->expiration = op->key;
+            key_set(e, op->key);
+            start = timer_start();
+            heap_insert(h, e);
+            test_record(r, HEAP_OP_INSERT, start);
+            break;
+        case TRACE_POP:
+            start = timer_start();
+            heap_pop(h);
+            test_record(r, HEAP_OP_POP, start);
+            break;
+        case TRACE_POP_MAX:
+            start = timer_start();
+            heap_pop_max(h);
+            test_record(r, HEAP_OP_POP, start);
+            break;
+        case TRACE_UPDATE:
+            if (h->update == NULL) {
+                break;
+            }
+            key_set(e, op->key);
+            start = timer_start();
+            heap_update_key(h, e, op->key);
+            test_record(r, HEAP_OP_UPDATE, start);
+            break;
+        default:
+            break;
+        }
+    }
+    test_phase(r, 2);
+    if (r->times.insertion == 0) {
+        r->times.insertion = r->times.end;
+        r->perf[1] = r->perf[2];
+        r->memory.live = r->memory.peak;
+        r->memory.rss[0] = r->memory.rss[1];
+        n_inserts = trace->hdr->n_ops;
+    }
+
+    /* Elements left after diverging on ties. */
+    while (heap_pop(h) != NULL) {
+    }
+    element_set_free(&set, &layout, &placement);
+
+    p->n_elems = n_inserts;
+}
+
+static void
+test_run_replay(struct heap *h, struct trace *trace)
+{
+    uint32_t types = trace->hdr->op_types;
+    struct test t = TEST_INITIALIZER;
+
+    if ((h->update == NULL && (types & (1u << TRACE_UPDATE))) ||
+        (h->pop_max == NULL && (types & (1u << TRACE_POP_MAX)))) {
+        printf("%*s: skipped, operations of the trace not supported.\n",
+               NAME_LEN, h->desc);
+        return;
+    }
+
+    t.params = (struct test_params) params;
+    t.params.p_update = trace->hdr->p_update;
+    t.params.p_shed = trace->hdr->p_shed;
+    t.h = h;
+
+    test_replay(&t, trace);
     test_print(&t);
 }
 
+static void
+test_run_workload(const struct workload *w, struct heap *h)
+{
+    struct workload_result r;
+    uint64_t ns;
+
+    if (!workload_run(w, h, &r)) {
+        printf("%*s: skipped, no key update.\n", NAME_LEN, h->desc);
+        return;
+    }
+
+    ns = timer_ns(r.start, r.end);
+    printf("%*s: %10.1lf %8.1lf %12llu %20llu\n", NAME_LEN, h->desc,
+           ns / 1e6, (double) ns / MAX(r.n_ops, 1), r.n_ops, r.result);
+    if (h->counts != NULL) {
+        test_counts_print(h);
+        heap_op_counts_reset(h);
+    }
+}
+
+/* Frequency scaling adds noise to the measures. */
+static void
+cpu_governor_check(void)
+{
+    const char *path = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor";
+    char governor[32] = "";
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        return;
+    }
+    if (fscanf(f, "%31s", governor) == 1 &&
+        strcmp(governor, "performance")) {
+        printf("CPU frequency governor is '%s', measures may vary:"
+               " consider 'performance'.\n", governor);
+    }
+    fclose(f);
+}
+
+static bool
+heap_selected(struct heap *h)
+{
+    const char *word = heap_selection;
+
+    /* Whole keys are not integers. */
+    if (key_is_whole() && h->key_cmp == NULL) {
+        return false;
+    }
+    if (word == NULL) {
+        return true;
+    }
+
+    while (*word != '\0') {
+        size_t len = strcspn(word, ",");
+        const char *desc = h->desc;
+
+        if (len > 0) {
+            while ((desc = strchr(desc, word[0])) != NULL) {
+                if (!strncmp(desc, word, len)) {
+                    return true;
+                }
+                desc++;
+            }
+        }
+        word += len;
+        word += (*word == ',');
+    }
+
+    return false;
+}
+
 int main(int argc, char * const argv[])
 {
     if (parse_params(argc, argv, &params) < 0) {
         usage(argv[0], -1);
     }
 
+    placement_reexec(&placement, argv);
+
     if (params.seed == 0) {
         params.seed = time_usec();
     }
     random_init(params.seed);
 
+    if (run_merge) {
+        merge_bench_run(&params);
+        return 0;
+    }
+
+    if (placement.cpu >= 0 || placement.node >= 0 ||
+        placement.pages != PLACEMENT_PAGES_DEFAULT) {
+        const char *err;
+
+        if (!placement_apply(&placement, &err)) {
+            fprintf(stderr, "Cannot place the bench: %s\n", err);
+            return 1;
+        }
+        placement_print(&placement);
+    }
+    if (layout.kind != LAYOUT_CONTIGUOUS) {
+        layout_print(&layout);
+    }
+    if (key_is_whole()) {
+        printf("Keys: %s, %u spins by comparison.\n",
+               key_type_name(element_key_type), element_cmp_cost);
+    }
+
+    timer_init(use_tsc);
+    if (use_memory && !alloc_enable()) {
+        printf("Allocations cannot be counted with this C library.\n");
+        use_memory = false;
+    }
+    if (use_perf) {
+        const char *err;
+
+        if (!perf_init(&err)) {
+            printf("Performance counters unavailable: %s.\n", err);
+            use_perf = false;
+        }
+    }
+
+    if (run_sweep) {
+        struct heap *selected[ARRAY_SIZE(heaps)];
+        static unsigned int p_update[] = { 0, 10, 30, };
+        size_t n = 0;
+
+        for (size_t i = 0; i < ARRAY_SIZE(heaps); i++) {
+            struct heap *h = run_counted ? counted_heaps[i] : heaps[i];
+
+            if (heap_selected(h)) {
+                selected[n++] = h;
+            }
+        }
+        if (n == 0) {
+            fprintf(stderr, "No heap selected.\n");
+            return 1;
+        }
+
+        /* Parameters not swept keep their single value. */
+        if (sweep.n_elems.n == 0) {
+            sweep.n_elems = (struct sweep_values) { &params.n_elems, 1 };
+        }
+        if (sweep.range.n == 0) {
+            sweep.range = (struct sweep_values) { &params.range, 1 };
+        }
+        if (sweep.p_update.n == 0) {
+            sweep.p_update = (struct sweep_values) {
+                p_update, ARRAY_SIZE(p_update),
+            };
+        }
+        sweep.counts = run_counted;
+        sweep.perf = use_perf;
+        sweep.memory = use_memory;
+        sweep_run(&sweep, &params, selected, n);
+        return 0;
+    }
+
+    if (n_threads > 0) {
+        struct heap *selected[ARRAY_SIZE(heaps)];
+        size_t n = 0;
+
+        for (size_t i = 0; i < ARRAY_SIZE(heaps); i++) {
+            struct heap *h = run_counted ? counted_heaps[i] : heaps[i];
+
+            if (heap_selected(h) &&
+                (params.p_update == 0 || h->update != NULL)) {
+                selected[n++] = h;
+            }
+        }
+        /* Counters and memory are measured for the main thread only. */
+        if (use_perf || use_memory) {
+            printf("Performance counters and memory are not measured"
+                   " with threads.\n");
+            use_perf = use_memory = false;
+        }
+        printf("Running on up to %u threads, %u elements each,"
+               " %u%% updates.\n", n_threads, params.n_elems,
+               params.p_update);
+        parallel_bench_run(&params, selected, n, n_threads, warmup,
+                           placement.cpu);
+        return 0;
+    }
+
+    if (sssp_path != NULL) {
+        sssp_bench_run(&params, sssp_path);
+        return 0;
+    }
+
+    if (workload_name != NULL) {
+        const struct workload *w = workload_find(workload_name);
+
+        if (!strcmp(workload_name, "list")) {
+            workload_list(stdout);
+            return 0;
+        }
+        if (w == NULL) {
+            fprintf(stderr, "Unknown workload '%s', available:\n",
+                    workload_name);
+            workload_list(stderr);
+            return 1;
+        }
+        printf("Workload %s: %s, on %u elements.\n", workload_name,
+               workload_desc(w), params.n_elems);
+        printf("%*s  %10s %8s %12s %20s\n", NAME_LEN, "Queue type",
+               "time (ms)", "ns/op", "ops", "result");
+        workload_init(w, &params);
+        for (size_t i = 0; i < ARRAY_SIZE(heaps); i++) {
+            struct heap *h = run_counted ? counted_heaps[i] : heaps[i];
+
+            if (heap_selected(h)) {
+                test_run_workload(w, h);
+            }
+        }
+        workload_finish(w);
+        return 0;
+    }
+
+    if (replay_path != NULL) {
+        struct trace trace;
+        const char *err;
+
+        if (!trace_map(&trace, replay_path, &err)) {
+            fprintf(stderr, "Cannot replay '%s': %s\n", replay_path, err);
+            return 1;
+        }
+        printf("Replaying %llu operations on %u elements from '%s'.\n",
+               (unsigned long long int) trace.hdr->n_ops,
+               trace.hdr->n_elems, replay_path);
+        test_column_print();
+        for (size_t i = 0; i < ARRAY_SIZE(heaps); i++) {
+            struct heap *h = run_counted ? counted_heaps[i] : heaps[i];
+
+            if (heap_selected(h)) {
+                test_run_replay(h, &trace);
+            }
+        }
+        trace_unmap(&trace);
+        return 0;
+    }
+
+    if (save_path != NULL) {
+        save_file = fopen(save_path, "w");
+        if (save_file == NULL) {
+            fprintf(stderr, "Cannot save into '%s': %s\n",
+                    save_path, strerror(errno));
+            return 1;
+        }
+    }
+    if (baseline_path != NULL) {
+        const char *err;
+
+        if (!baseline_load(&baseline, baseline_path, &err)) {
+            fprintf(stderr, "Cannot load the baseline '%s': %s\n",
+                    baseline_path, err);
+            return 1;
+        }
+    }
+
+    cpu_governor_check();
     test_column_print();
-    test_run(&min_pairing_heap);
-    test_run(&min_fibonacci_heap);
-    test_run(&min_binary_heap);
+    for (size_t i = 0; i < ARRAY_SIZE(heaps); i++) {
+        struct heap *h = run_counted ? counted_heaps[i] : heaps[i];
+
+        if (heap_selected(h)) {
+            test_run(h);
+        }
+    }
+
+    if (save_file != NULL && fclose(save_file) != 0) {
+        fprintf(stderr, "Failed to write '%s'\n", save_path);
+        return 1;
+    }
+    if (baseline_path != NULL) {
+        baseline_destroy(&baseline);
+        printf("%u significant regressions against '%s'.\n",
+               n_regressions, baseline_path);
+        return n_regressions > 0;
+    }
 
     return 0;
 }
@@ -0,0 +1,249 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* Count the work of the merge queues. */
+#define HEAP_COUNTING
+
+#include <limits.h>
+#include <stdio.h>
+
+#include "util.h"
+#include "heap.h"
+
+#include "binary-heap.h"
+#include "pairing-heap.h"
+#include "tournament-tree.h"
+
+#include "bench.h"
+
+/* K-way merge of sorted runs, using either the tournament tree
+ * or a heap as the merge queue, holding the head of each run. */
+
+struct merge_run {
+    struct pheap_node node;
+    long long int *values;
+    size_t head;
+    size_t n;
+};
+
+struct merge_test {
+    struct merge_run *runs;
+    size_t k;
+    size_t n;
+    /* Check the output order. */
+    long long int last;
+    size_t count;
+};
+
+static void
+merge_output(struct merge_test *m, long long int v)
+{
+    if (v < m->last) {
+        fprintf(stderr, "Merge output is not sorted.\n");
+        abort();
+    }
+    m->last = v;
+    m->count++;
+}
+
+static int
+lli_cmp(const void *_a, const void *_b)
+{
+    const long long int *a = _a, *b = _b;
+
+    return (*a > *b) - (*a < *b);
+}
+
+static void
+merge_test_init(struct merge_test *m, size_t n, size_t k, unsigned int range)
+{
+    long long int *values = xmalloc(n * sizeof values[0]);
+    size_t i, start = 0;
+
+    for (i = 0; i < n; i++) {
+        values[i] = random_u32_range(range);
+    }
+
+    m->runs = xcalloc(k, sizeof m->runs[0]);
+    m->k = k;
+    m->n = n;
+    for (i = 0; i < k; i++) {
+        struct merge_run *r = &m->runs[i];
+
+        r->values = &values[start];
+        r->n = n / k + (i < n % k);
+        qsort(r->values, r->n, sizeof r->values[0], lli_cmp);
+        start += r->n;
+    }
+}
+
+static void
+merge_test_reset(struct merge_test *m)
+{
+    for (size_t i = 0; i < m->k; i++) {
+        m->runs[i].head = 0;
+    }
+    m->last = LLONG_MIN;
+    m->count = 0;
+}
+
+static void
+merge_test_destroy(struct merge_test *m)
+{
+    free(m->runs[0].values);
+    free(m->runs);
+}
+
+static void
+merge_test_check(struct merge_test *m)
+{
+    if (m->count != m->n) {
+        fprintf(stderr, "Merged %zu elements out of %zu.\n", m->count, m->n);
+        abort();
+    }
+}
+
+static int
+ttree_node_cmp(struct ttree_node *a, struct ttree_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+static bool
+merge_cursor(void *aux, size_t run, struct ttree_node *n)
+{
+    struct merge_test *m = aux;
+    struct merge_run *r = &m->runs[run];
+
+    if (r->head == r->n) {
+        return false;
+    }
+    n->data = &r->values[r->head];
+    n->priority.lli = r->values[r->head++];
+    return true;
+}
+
+static void
+merge_tournament_tree(struct merge_test *m)
+{
+    struct ttree t;
+    long long int *v;
+
+    if (!ttree_init(&t, ttree_node_cmp, m->k, merge_cursor, m)) {
+        out_of_memory();
+    }
+    while ((v = ttree_next(&t)) != NULL) {
+        merge_output(m, *v);
+    }
+    ttree_finish(&t);
+}
+
+static int
+bheap_node_cmp(struct bheap_node *a, struct bheap_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+static void
+merge_binary_heap(struct merge_test *m)
+{
+    struct bheap h = BHEAP_INITIALIZER(bheap_node_cmp);
+    struct merge_run *r;
+
+    for (size_t i = 0; i < m->k; i++) {
+        r = &m->runs[i];
+        if (r->head < r->n) {
+            bheap_insert(&h, (struct bheap_node) {
+                .data = r, .priority.lli = r->values[r->head],
+            });
+        }
+    }
+    while ((r = bheap_pop(&h)) != NULL) {
+        merge_output(m, r->values[r->head++]);
+        if (r->head < r->n) {
+            bheap_insert(&h, (struct bheap_node) {
+                .data = r, .priority.lli = r->values[r->head],
+            });
+        }
+    }
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static int
+pheap_run_cmp(struct pheap_node *a, struct pheap_node *b)
+{
+    struct merge_run *r[2] = {
+        container_of(a, struct merge_run, node),
+        container_of(b, struct merge_run, node),
+    };
+
+    return min_priority_cmp(r[0]->values[r[0]->head],
+                            r[1]->values[r[1]->head]);
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static void
+merge_pairing_heap(struct merge_test *m)
+{
+    struct pheap h = PHEAP_INITIALIZER(pheap_run_cmp);
+    struct pheap_node *node;
+    struct merge_run *r;
+
+    for (size_t i = 0; i < m->k; i++) {
+        r = &m->runs[i];
+        if (r->head < r->n) {
+            pheap_insert(&h, &r->node);
+        }
+    }
+    while ((node = pheap_pop(&h)) != NULL) {
+        r = container_of(node, struct merge_run, node);
+        merge_output(m, r->values[r->head++]);
+        if (r->head < r->n) {
+            pheap_insert(&h, &r->node);
+        }
+    }
+}
+
+static struct {
+    const char *desc;
+    void (*merge)(struct merge_test *m);
+} merge_engines[] = {
+    { "tournament-tree", merge_tournament_tree, },
+    { "binary-heap", merge_binary_heap, },
+    { "pairing-heap", merge_pairing_heap, },
+};
+
+#define MERGE_K_MAX 4096
+
+void
+merge_bench_run(struct test_params *params)
+{
+    struct merge_test m;
+    size_t i, k;
+
+    printf("%*s %*s %*s %*s\n", 6, "k", 24, "Merge queue",
+           10, "merge (ms)", 10, "cmp/elem");
+
+    for (k = 2; k <= MERGE_K_MAX; k *= 2) {
+        merge_test_init(&m, params->n_elems, k, params->range);
+
+        for (i = 0; i < ARRAY_SIZE(merge_engines); i++) {
+            long long int start;
+            long long int end;
+
+            merge_test_reset(&m);
+            heap_counts_reset();
+            start = time_usec();
+            merge_engines[i].merge(&m);
+            end = time_usec();
+            merge_test_check(&m);
+
+            printf("%*zu %*s %10.1lf %10.2lf\n", 6, k,
+                   24, merge_engines[i].desc,
+                   (end - start) / 1000., (double) heap_counts.cmp / m.n);
+        }
+
+        merge_test_destroy(&m);
+    }
+}
@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util.h"
+#include "heap.h"
+#include "timer.h"
+
+#include "bench.h"
+#include "placement.h"
+
+/* Run the test on several threads at once, each driving its own
+ * instance of the heap with its own elements and random sequence,
+ * as one shard per core would. Threads start together, and the
+ * throughput is that of all their operations over the time of the
+ * slowest one. Thread counts double up to the maximum, the speedup
+ * being relative to a single thread. */
+
+struct parallel_run {
+    const struct heap *proto;
+    const struct test_params *params;
+    unsigned int warmup;
+    /* First CPU to pin threads to, -1 if not pinned. */
+    int first_cpu;
+    pthread_barrier_t barrier;
+};
+
+struct parallel_thread {
+    pthread_t id;
+    struct parallel_run *run;
+    unsigned int index;
+    struct test *t;
+};
+
+static void *
+parallel_thread_main(void *arg)
+{
+    struct parallel_thread *th = arg;
+    struct parallel_run *run = th->run;
+    struct test *t = th->t;
+
+    if (run->first_cpu >= 0) {
+        const char *err;
+
+        if (!placement_pin(run->first_cpu + th->index, &err)) {
+            printf("Cannot pin thread %u to CPU %u: %s.\n", th->index,
+                   run->first_cpu + th->index, err);
+        }
+    }
+
+    t->h = heap_create(run->proto);
+    t->params = *run->params;
+    t->params.seed += th->index;
+    for (unsigned int w = 0; w < run->warmup; w++) {
+        random_init(t->params.seed);
+        test_execute(t);
+    }
+    random_init(t->params.seed);
+
+    pthread_barrier_wait(&run->barrier);
+    test_execute(t);
+
+    heap_destroy(t->h);
+    t->h = NULL;
+    return NULL;
+}
+
+struct parallel_result {
+    /* Operations of all threads, per second. */
+    double mops;
+    /* Average time of an operation within a thread. */
+    double ns_per_op;
+};
+
+static void
+parallel_execute(struct parallel_run *run, unsigned int n_threads,
+                 struct parallel_result *res)
+{
+    struct parallel_thread *threads = xcalloc(n_threads, sizeof threads[0]);
+    unsigned long long int n_ops = 0;
+    double ns_sum = 0;
+    double ns_max = 0;
+    unsigned int i;
+
+    pthread_barrier_init(&run->barrier, NULL, n_threads);
+    for (i = 0; i < n_threads; i++) {
+        threads[i].run = run;
+        threads[i].index = i;
+        threads[i].t = xzalloc(sizeof *threads[i].t);
+        *threads[i].t = (struct test) TEST_INITIALIZER;
+        if (pthread_create(&threads[i].id, NULL, parallel_thread_main,
+                           &threads[i]) != 0) {
+            fprintf(stderr, "Failed to create thread %u.\n", i);
+            abort();
+        }
+    }
+
+    for (i = 0; i < n_threads; i++) {
+        struct test *t = threads[i].t;
+        unsigned long long int n;
+        double ns;
+
+        pthread_join(threads[i].id, NULL);
+        n = test_phase_ops(t, 0) + test_phase_ops(t, 1);
+        /* Each operation having been timed, remove the timer overhead. */
+        ns = ((double) (t->results.times.end - t->results.times.start) -
+              (double) n * timer.overhead) / timer.freq;
+        n_ops += n;
+        ns_sum += ns / MAX(n, 1);
+        ns_max = MAX(ns_max, ns);
+        free(t);
+    }
+    pthread_barrier_destroy(&run->barrier);
+    free(threads);
+
+    res->mops = ns_max > 0 ? n_ops / ns_max * 1000 : 0;
+    res->ns_per_op = ns_sum / n_threads;
+}
+
+void
+parallel_bench_run(struct test_params *params, struct heap **heaps,
+                   size_t n_heaps, unsigned int max_threads,
+                   unsigned int warmup, int first_cpu)
+{
+    struct parallel_run run = {
+        .params = params,
+        .warmup = warmup,
+        .first_cpu = first_cpu,
+    };
+
+    printf("%*s %8s %10s %12s %8s %10s\n", 24, "Queue type",
+           "threads", "Mops/s", "ns/op", "speedup", "efficiency");
+
+    for (size_t i = 0; i < n_heaps; i++) {
+        struct parallel_result single = { 0 };
+        unsigned int n = 1;
+
+        run.proto = heaps[i];
+        for (;;) {
+            struct parallel_result res;
+            double speedup;
+
+            parallel_execute(&run, n, &res);
+            if (n == 1) {
+                single = res;
+            }
+            speedup = single.mops > 0 ? res.mops / single.mops : 0;
+            printf("%*s %8u %10.2lf %12.1lf %8.2lf %9.0lf%%\n", 24,
+                   n == 1 ? heaps[i]->desc : "", n, res.mops,
+                   res.ns_per_op, speedup, 100 * speedup / n);
+
+            if (n == max_threads) {
+                break;
+            }
+            n = MIN(2 * n, max_threads);
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "util.h"
+
+#include "perf.h"
+
+const char *perf_event_desc[PERF_N_EVENTS] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instr",
+    [PERF_BRANCH_MISSES] = "br-miss",
+    [PERF_L1D_MISSES] = "L1d-miss",
+    [PERF_LLC_MISSES] = "LLC-miss",
+    [PERF_DTLB_MISSES] = "dTLB-miss",
+};
+
+#define PERF_CACHE_READ_MISS(CACHE) \
+    ((CACHE) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perf_events[PERF_N_EVENTS] = {
+    [PERF_CYCLES] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+    },
+    [PERF_INSTRUCTIONS] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+    },
+    [PERF_BRANCH_MISSES] = {
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,
+    },
+    [PERF_L1D_MISSES] = {
+        PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D),
+    },
+    [PERF_LLC_MISSES] = {
+        PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL),
+    },
+    [PERF_DTLB_MISSES] = {
+        PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB),
+    },
+};
+
+/* Events of each group, the first one leading it. */
+#define PERF_N_GROUPS 2
+#define PERF_GROUP_SIZE 3
+
+static const enum perf_event_id perf_groups[PERF_N_GROUPS][PERF_GROUP_SIZE] = {
+    { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_BRANCH_MISSES, },
+    { PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_DTLB_MISSES, },
+};
+
+static struct {
+    int fd[PERF_N_EVENTS];
+    /* Leader of each group, -1 if it could not be opened. */
+    int leader[PERF_N_GROUPS];
+    /* Events of each group in the order they were opened. */
+    enum perf_event_id members[PERF_N_GROUPS][PERF_GROUP_SIZE];
+    size_t n_members[PERF_N_GROUPS];
+} perf = {
+    .leader = { -1, -1, },
+};
+
+static int
+perf_open(enum perf_event_id id, int group_fd)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = perf_events[id].type;
+    attr.config = perf_events[id].config;
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    /* Only the leader starts disabled, members follow it. */
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void
+perf_close(void)
+{
+    for (size_t g = 0; g < PERF_N_GROUPS; g++) {
+        for (size_t i = 0; i < perf.n_members[g]; i++) {
+            close(perf.fd[perf.members[g][i]]);
+        }
+        perf.n_members[g] = 0;
+        perf.leader[g] = -1;
+    }
+}
+
+bool
+perf_init(const char **err)
+{
+    int error = ENOENT;
+    bool any = false;
+
+    perf_close();
+    for (size_t g = 0; g < PERF_N_GROUPS; g++) {
+        for (size_t i = 0; i < PERF_GROUP_SIZE; i++) {
+            enum perf_event_id id = perf_groups[g][i];
+            int fd = perf_open(id, perf.leader[g]);
+
+            if (fd < 0) {
+                error = errno;
+                continue;
+            }
+            if (perf.leader[g] == -1) {
+                perf.leader[g] = fd;
+            }
+            perf.fd[id] = fd;
+            perf.members[g][perf.n_members[g]++] = id;
+        }
+        if (perf.leader[g] != -1) {
+            ioctl(perf.leader[g], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(perf.leader[g], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            any = true;
+        }
+    }
+
+    if (!any) {
+        *err = (error == EACCES || error == EPERM)
+               ? "access denied, see /proc/sys/kernel/perf_event_paranoid"
+               : strerror(error);
+    }
+    return any;
+}
+
+void
+perf_read(struct perf_sample *s)
+{
+    /* Number of values, time enabled, time running, then values. */
+    uint64_t buf[3 + PERF_GROUP_SIZE];
+
+    memset(s, 0, sizeof *s);
+    for (size_t g = 0; g < PERF_N_GROUPS; g++) {
+        size_t n = perf.n_members[g];
+        double scale;
+
+        if (n == 0 ||
+            read(perf.leader[g], buf, sizeof buf) < (ssize_t) ((3 + n) * 8) ||
+            buf[0] != n || buf[2] == 0) {
+            continue;
+        }
+        scale = (double) buf[1] / buf[2];
+        for (size_t i = 0; i < n; i++) {
+            enum perf_event_id id = perf.members[g][i];
+
+            s->v[id] = buf[3 + i] * scale;
+            s->valid[id] = true;
+        }
+    }
+}
+
+void
+perf_diff(const struct perf_sample *a, const struct perf_sample *b,
+          struct perf_sample *d)
+{
+    for (size_t i = 0; i < PERF_N_EVENTS; i++) {
+        d->valid[i] = a->valid[i] && b->valid[i];
+        d->v[i] = d->valid[i] ? MAX(b->v[i] - a->v[i], 0) : 0;
+    }
+}
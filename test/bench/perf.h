@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Hardware performance counters.
+ *
+ * Counters are opened through perf_event_open(2) for the calling
+ * thread, user space only, in groups read at once: a group is
+ * scheduled on the PMU as a whole, keeping the ratios of its events
+ * consistent. Two groups are used, as most PMUs cannot count all
+ * events together. When groups are multiplexed, their values are
+ * scaled by the fraction of the time they were running.
+ *
+ * Events that cannot be opened are left out, e.g. in virtual machines
+ * or when 'perf_event_paranoid' restricts access: 'perf_init' then
+ * returns false with the reason, and reads are left empty.
+ */
+
+enum perf_event_id {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_N_EVENTS,
+};
+
+struct perf_sample {
+    /* Set for the events that could be read. */
+    bool valid[PERF_N_EVENTS];
+    double v[PERF_N_EVENTS];
+};
+
+extern const char *perf_event_desc[PERF_N_EVENTS];
+
+/* Open the counters and start them. Returns false if none
+ * could be opened, setting 'err'. Can be called again. */
+bool perf_init(const char **err);
+/* Read the current value of all counters. */
+void perf_read(struct perf_sample *s);
+/* Write the difference of 'b' and 'a' into 'd'. */
+void perf_diff(const struct perf_sample *a, const struct perf_sample *b,
+               struct perf_sample *d);
+
+#endif /* PERF_H */
@@ -0,0 +1,226 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "util.h"
+
+#include "placement.h"
+
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+#define MALLOC_TUNABLE "glibc.malloc.hugetlb"
+
+/* Explicit huge pages could not be mapped, transparent ones are used. */
+static bool hugetlb_failed;
+
+static const char *pages_desc[] = {
+    [PLACEMENT_PAGES_DEFAULT] = "none",
+    [PLACEMENT_PAGES_THP] = "thp",
+    [PLACEMENT_PAGES_HUGETLB] = "hugetlb",
+};
+
+bool
+placement_pages_parse(const char *s, enum placement_pages *pages)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(pages_desc); i++) {
+        if (!strcmp(s, pages_desc[i])) {
+            *pages = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool
+malloc_tunable_set(void)
+{
+    const char *tunables = getenv("GLIBC_TUNABLES");
+
+    return tunables != NULL && strstr(tunables, MALLOC_TUNABLE) != NULL;
+}
+
+void
+placement_reexec(struct placement *p, char * const argv[])
+{
+    const char *tunables = getenv("GLIBC_TUNABLES");
+    char *value;
+
+    if (p->pages == PLACEMENT_PAGES_DEFAULT || malloc_tunable_set()) {
+        return;
+    }
+
+    /* 1 advises transparent huge pages, 2 uses the hugetlbfs pool. */
+    if (asprintf(&value, "%s%s" MALLOC_TUNABLE "=%d",
+                 tunables ? tunables : "", tunables ? ":" : "",
+                 p->pages == PLACEMENT_PAGES_THP ? 1 : 2) < 0) {
+        out_of_memory();
+    }
+    setenv("GLIBC_TUNABLES", value, 1);
+    free(value);
+
+    fflush(stdout);
+    execv("/proc/self/exe", argv);
+    /* Go on with the usual pages for malloc. */
+}
+
+static unsigned long int
+node_mask(int node)
+{
+    return 1UL << node;
+}
+
+bool
+placement_pin(int cpu, const char **err)
+{
+    cpu_set_t set;
+
+    if (cpu >= CPU_SETSIZE) {
+        *err = "CPU out of range";
+        return false;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof set, &set) != 0) {
+        *err = strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool
+placement_apply(struct placement *p, const char **err)
+{
+    if (p->cpu >= 0 && !placement_pin(p->cpu, err)) {
+        return false;
+    }
+
+    if (p->node >= 0) {
+        unsigned long int mask = node_mask(p->node);
+
+        if (p->node >= (int) (8 * sizeof mask)) {
+            *err = "node out of range";
+            return false;
+        }
+        if (syscall(SYS_set_mempolicy, MPOL_BIND, &mask,
+                    8 * sizeof mask) != 0) {
+            *err = strerror(errno);
+            return false;
+        }
+    }
+
+    /* Check the pool once, rather than on each allocation. */
+    if (p->pages == PLACEMENT_PAGES_HUGETLB) {
+        void *mem = mmap(NULL, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (mem == MAP_FAILED) {
+            printf("Explicit huge pages unavailable: %s,"
+                   " using transparent ones.\n", strerror(errno));
+            hugetlb_failed = true;
+        } else {
+            munmap(mem, HUGE_PAGE_SIZE);
+        }
+    }
+
+    return true;
+}
+
+void
+placement_print(struct placement *p)
+{
+    printf("Placement: ");
+    if (p->cpu >= 0) {
+        printf("pinned to CPU %d", p->cpu);
+    } else {
+        printf("not pinned");
+    }
+    if (p->node >= 0) {
+        printf(", memory bound to node %d", p->node);
+    }
+    switch (p->pages) {
+    case PLACEMENT_PAGES_DEFAULT:
+        printf(", default pages");
+        break;
+    case PLACEMENT_PAGES_THP:
+        printf(", elements on transparent huge pages");
+        break;
+    case PLACEMENT_PAGES_HUGETLB:
+        printf(", elements on %s huge pages",
+               hugetlb_failed ? "transparent" : "explicit");
+        break;
+    }
+    if (p->pages != PLACEMENT_PAGES_DEFAULT) {
+        printf(", %s", malloc_tunable_set() ? "malloc huge pages requested"
+                                             : "malloc on default pages");
+    }
+    printf(".\n");
+}
+
+void *
+placement_alloc(struct placement *p, size_t size)
+{
+    size_t len = (MAX(size, 1) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    char *mem = MAP_FAILED;
+    char *aligned;
+    size_t head;
+
+    if (p->pages == PLACEMENT_PAGES_DEFAULT) {
+        return xzalloc(size);
+    }
+
+    if (p->pages == PLACEMENT_PAGES_HUGETLB && !hugetlb_failed) {
+        mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   flags | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            return mem;
+        }
+        /* The pool is too small for this size. */
+        printf("Not enough explicit huge pages for %zu bytes,"
+               " using transparent ones.\n", size);
+        hugetlb_failed = true;
+    }
+
+    /* Transparent huge pages need an aligned range:
+     * map one more page and trim the ends. */
+    mem = mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+               flags, -1, 0);
+    if (mem == MAP_FAILED) {
+        out_of_memory();
+    }
+    aligned = (char *) (((uintptr_t) mem + HUGE_PAGE_SIZE - 1) &
+                        ~(HUGE_PAGE_SIZE - 1));
+    head = aligned - mem;
+    if (head > 0) {
+        munmap(mem, head);
+    }
+    munmap(aligned + len, HUGE_PAGE_SIZE - head);
+    madvise(aligned, len, MADV_HUGEPAGE);
+
+    return aligned;
+}
+
+void
+placement_free(struct placement *p, void *mem, size_t size)
+{
+    size_t len = (MAX(size, 1) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+    if (p->pages == PLACEMENT_PAGES_DEFAULT) {
+        free(mem);
+        return;
+    }
+    munmap(mem, len);
+}
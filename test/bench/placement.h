@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Placement of the bench on the machine.
+ *
+ * The bench thread can be pinned to a CPU, and its memory bound
+ * to a NUMA node through the memory policy of the process, using
+ * the system calls directly: libnuma is not needed.
+ *
+ * Elements can be backed by transparent huge pages, advised on
+ * an aligned mapping, or by explicit huge pages from the hugetlbfs
+ * pool, falling back to transparent ones if the pool is empty.
+ * The storage allocated by heaps comes from malloc: glibc is asked
+ * to use huge pages through its 'glibc.malloc.hugetlb' tunable,
+ * which must be set before the program starts. The bench thus
+ * executes itself again once with the tunable set.
+ */
+
+enum placement_pages {
+    PLACEMENT_PAGES_DEFAULT,
+    PLACEMENT_PAGES_THP,
+    PLACEMENT_PAGES_HUGETLB,
+};
+
+struct placement {
+    /* -1 if not set. */
+    int cpu;
+    int node;
+    enum placement_pages pages;
+};
+
+#define PLACEMENT_INITIALIZER { \
+    .cpu = -1, .node = -1, \
+    .pages = PLACEMENT_PAGES_DEFAULT, \
+}
+
+bool placement_pages_parse(const char *s, enum placement_pages *pages);
+/* Execute the program again with the malloc tunable matching
+ * 'p' if it is not set. Only returns if nothing was done. */
+void placement_reexec(struct placement *p, char * const argv[]);
+/* Pin the thread and bind the memory. Returns false on failure,
+ * setting 'err'. */
+bool placement_apply(struct placement *p, const char **err);
+/* Pin the calling thread to 'cpu'. */
+bool placement_pin(int cpu, const char **err);
+/* Print the placement in use, on a single line. */
+void placement_print(struct placement *p);
+
+/* Allocate zeroed memory for 'size' bytes of elements. */
+void *placement_alloc(struct placement *p, size_t size);
+void placement_free(struct placement *p, void *mem, size_t size);
+
+#endif /* PLACEMENT_H */
@@ -0,0 +1,268 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* Count the work of the queues. */
+#define HEAP_COUNTING
+
+#include <limits.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "heap.h"
+#include "timer.h"
+
+#include "binary-heap.h"
+#include "fibonacci-heap.h"
+#include "pairing-heap.h"
+
+#include "bench.h"
+#include "graph.h"
+
+/* Single-source shortest paths, using the native key decrease
+ * of each heap: the benchmark of graph searches where the
+ * pairing and fibonacci heaps are usually compared. */
+
+struct sssp_vertex {
+    union {
+        struct pheap_node pnode;
+        struct fheap_node fnode;
+    };
+    long long int dist;
+    bool queued;
+    bool settled;
+};
+
+struct sssp_test {
+    struct graph g;
+    struct sssp_vertex *v;
+    size_t source;
+    size_t n_settled;
+    size_t n_decrease;
+    /* Sum of the distances, the same for all queues. */
+    unsigned long long int checksum;
+};
+
+/* Queue used by the search, holding vertices by distance. */
+struct sssp_engine {
+    const char *desc;
+    void (*init)(void);
+    void (*insert)(struct sssp_vertex *v);
+    /* The distance of 'v' has been decreased. */
+    void (*decrease)(struct sssp_vertex *v);
+    struct sssp_vertex *(*pop)(void);
+};
+
+ALLOW_UNDEFINED_BEHAVIOR
+static int
+pheap_vertex_cmp(struct pheap_node *a, struct pheap_node *b)
+{
+    return min_priority_cmp(container_of(a, struct sssp_vertex, pnode)->dist,
+                            container_of(b, struct sssp_vertex, pnode)->dist);
+}
+
+static struct pheap pheap = PHEAP_INITIALIZER(pheap_vertex_cmp);
+
+static void
+pairing_init(void)
+{
+    pheap_init(&pheap, pheap_vertex_cmp);
+}
+
+static void
+pairing_insert(struct sssp_vertex *v)
+{
+    pheap_insert(&pheap, &v->pnode);
+}
+
+static void
+pairing_decrease(struct sssp_vertex *v)
+{
+    pheap_reinsert(&pheap, &v->pnode);
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static struct sssp_vertex *
+pairing_pop(void)
+{
+    struct pheap_node *n = pheap_pop(&pheap);
+
+    return n == NULL ? NULL : container_of(n, struct sssp_vertex, pnode);
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static int
+fheap_vertex_cmp(struct fheap_node *a, struct fheap_node *b)
+{
+    return min_priority_cmp(container_of(a, struct sssp_vertex, fnode)->dist,
+                            container_of(b, struct sssp_vertex, fnode)->dist);
+}
+
+static struct fheap fheap = FHEAP_INITIALIZER(fheap_vertex_cmp);
+
+static void
+fibonacci_init(void)
+{
+    fheap_init(&fheap, fheap_vertex_cmp);
+}
+
+static void
+fibonacci_insert(struct sssp_vertex *v)
+{
+    fheap_insert(&fheap, &v->fnode);
+}
+
+static void
+fibonacci_decrease(struct sssp_vertex *v)
+{
+    fheap_update_key(&fheap, &v->fnode);
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static struct sssp_vertex *
+fibonacci_pop(void)
+{
+    struct fheap_node *n = fheap_pop(&fheap);
+
+    return n == NULL ? NULL : container_of(n, struct sssp_vertex, fnode);
+}
+
+static int
+bheap_vertex_cmp(struct bheap_node *a, struct bheap_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+static struct bheap bheap = BHEAP_INITIALIZER(bheap_vertex_cmp);
+
+static void
+binary_init(void)
+{
+    bheap_init(&bheap, bheap_vertex_cmp);
+}
+
+static void
+binary_insert(struct sssp_vertex *v)
+{
+    bheap_insert(&bheap, (struct bheap_node) {
+        .data = v, .priority.lli = v->dist,
+    });
+}
+
+static void
+binary_decrease(struct sssp_vertex *v)
+{
+    bheap_update_key(&bheap, (struct bheap_node) {
+        .data = v, .priority.lli = v->dist,
+    });
+}
+
+static struct sssp_vertex *
+binary_pop(void)
+{
+    return bheap_pop(&bheap);
+}
+
+static const struct sssp_engine sssp_engines[] = {
+    { "pairing-heap", pairing_init, pairing_insert,
+      pairing_decrease, pairing_pop, },
+    { "fibonacci-heap", fibonacci_init, fibonacci_insert,
+      fibonacci_decrease, fibonacci_pop, },
+    { "binary-heap", binary_init, binary_insert,
+      binary_decrease, binary_pop, },
+};
+
+static void
+sssp_search(struct sssp_test *t, const struct sssp_engine *e)
+{
+    struct sssp_vertex *u;
+    size_t i;
+
+    for (i = 0; i < t->g.n; i++) {
+        t->v[i].dist = LLONG_MAX;
+        t->v[i].queued = false;
+        t->v[i].settled = false;
+    }
+    t->n_settled = 0;
+    t->n_decrease = 0;
+    t->checksum = 0;
+
+    e->init();
+    t->v[t->source].dist = 0;
+    t->v[t->source].queued = true;
+    e->insert(&t->v[t->source]);
+
+    while ((u = e->pop()) != NULL) {
+        size_t x = u - t->v;
+
+        u->settled = true;
+        t->n_settled++;
+        t->checksum += u->dist;
+
+        for (i = t->g.first[x]; i < t->g.first[x + 1]; i++) {
+            struct sssp_vertex *v = &t->v[t->g.dst[i]];
+            long long int d = u->dist + t->g.weight[i];
+
+            if (v->settled) {
+                continue;
+            }
+            if (!v->queued) {
+                v->dist = d;
+                v->queued = true;
+                e->insert(v);
+            } else if (d < v->dist) {
+                v->dist = d;
+                e->decrease(v);
+                t->n_decrease++;
+            }
+        }
+    }
+}
+
+void
+sssp_bench_run(struct test_params *params, const char *path)
+{
+    struct sssp_test t;
+    size_t i;
+
+    if (access(path, F_OK) == 0) {
+        const char *err;
+
+        if (!graph_load_dimacs(&t.g, path, &err)) {
+            fprintf(stderr, "Cannot load '%s': %s\n", path, err);
+            exit(1);
+        }
+        printf("Graph '%s': ", path);
+    } else {
+        graph_road_grid(&t.g, params->n_elems);
+        printf("'%s' not found, generated a road-like grid: ", path);
+    }
+
+    t.v = xcalloc(t.g.n, sizeof t.v[0]);
+    t.source = random_u32_range(t.g.n);
+    /* Numbered from 1, as in DIMACS files. */
+    printf("%zu vertices, %zu arcs, source %zu.\n",
+           t.g.n, t.g.m, t.source + 1);
+    printf("%*s %10s %10s %10s %12s %20s\n", 24, "Queue type",
+           "time (ms)", "Mnodes/s", "cmp/node", "decrease", "checksum");
+
+    for (i = 0; i < ARRAY_SIZE(sssp_engines); i++) {
+        uint64_t start;
+        uint64_t ns;
+
+        heap_counts_reset();
+        start = timer_start();
+        sssp_search(&t, &sssp_engines[i]);
+        ns = MAX(timer_ns(start, timer_stop()), 1);
+
+        printf("%*s %10.1lf %10.2lf %10.2lf %12zu %20llu\n",
+               24, sssp_engines[i].desc, ns / 1e6,
+               t.n_settled * 1e3 / ns,
+               (double) heap_counts.cmp / MAX(t.n_settled, 1),
+               t.n_decrease, t.checksum);
+    }
+
+    free(t.v);
+    graph_destroy(&t.g);
+}
@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#include "stats.h"
+
+/* Resamples drawn by bootstrap. */
+#define STATS_BOOTSTRAP_N 2000
+
+void
+samples_add(struct samples *s, double v)
+{
+    if (s->n == s->capacity) {
+        s->capacity = MAX(2 * s->capacity, 16);
+        s->v = realloc(s->v, s->capacity * sizeof s->v[0]);
+        if (s->v == NULL) {
+            out_of_memory();
+        }
+    }
+    s->v[s->n++] = v;
+    mov_avg_cma_update(&s->cma, v);
+}
+
+void
+samples_clear(struct samples *s)
+{
+    s->n = 0;
+    mov_avg_cma_init(&s->cma);
+}
+
+void
+samples_destroy(struct samples *s)
+{
+    free(s->v);
+    *s = (struct samples) SAMPLES_INITIALIZER;
+}
+
+static int
+double_cmp(const void *_a, const void *_b)
+{
+    const double *a = _a, *b = _b;
+
+    return (*a > *b) - (*a < *b);
+}
+
+/* Percentile 'p' of the 'n' sorted values 'v', interpolated. */
+static double
+sorted_percentile(const double *v, size_t n, double p)
+{
+    double rank = p / 100. * (n - 1);
+    size_t i = rank;
+
+    if (i + 1 >= n) {
+        return v[n - 1];
+    }
+    return v[i] + (rank - i) * (v[i + 1] - v[i]);
+}
+
+static double
+median(double *v, size_t n)
+{
+    qsort(v, n, sizeof v[0], double_cmp);
+    return sorted_percentile(v, n, 50);
+}
+
+static uint32_t stats_rng = 0x9e3779b9;
+
+/* Median of 'n' values drawn with replacement from 'v' into 'tmp'. */
+static double
+resample_median(const double *v, size_t n, double *tmp)
+{
+    for (size_t i = 0; i < n; i++) {
+        tmp[i] = v[xorshift32(&stats_rng) % n];
+    }
+    return median(tmp, n);
+}
+
+void
+samples_summarize(struct samples *s, struct samples_summary *sum)
+{
+    double *sorted = xmalloc(s->n * sizeof sorted[0]);
+    double *boot = xmalloc(STATS_BOOTSTRAP_N * sizeof boot[0]);
+    double *tmp = xmalloc(s->n * sizeof tmp[0]);
+    double q1, q3, iqr;
+    size_t i;
+
+    memcpy(sorted, s->v, s->n * sizeof sorted[0]);
+    sum->median = median(sorted, s->n);
+    sum->mean = mov_avg_cma(&s->cma);
+    sum->std_dev = mov_avg_cma_std_dev(&s->cma);
+
+    q1 = sorted_percentile(sorted, s->n, 25);
+    q3 = sorted_percentile(sorted, s->n, 75);
+    iqr = q3 - q1;
+    sum->n_outliers = 0;
+    for (i = 0; i < s->n; i++) {
+        if (s->v[i] < q1 - 1.5 * iqr || s->v[i] > q3 + 1.5 * iqr) {
+            sum->n_outliers++;
+        }
+    }
+
+    for (i = 0; i < STATS_BOOTSTRAP_N; i++) {
+        boot[i] = resample_median(sorted, s->n, tmp);
+    }
+    qsort(boot, STATS_BOOTSTRAP_N, sizeof boot[0], double_cmp);
+    sum->lo = sorted_percentile(boot, STATS_BOOTSTRAP_N, 2.5);
+    sum->hi = sorted_percentile(boot, STATS_BOOTSTRAP_N, 97.5);
+
+    free(tmp);
+    free(boot);
+    free(sorted);
+}
+
+bool
+samples_compare(struct samples *a, struct samples *b, double noise,
+                double *ratio, double *lo, double *hi)
+{
+    double *boot = xmalloc(STATS_BOOTSTRAP_N * sizeof boot[0]);
+    double *tmp = xmalloc(MAX(a->n, b->n) * sizeof tmp[0]);
+    double ma, mb;
+    size_t i;
+
+    memcpy(tmp, a->v, a->n * sizeof tmp[0]);
+    ma = median(tmp, a->n);
+    memcpy(tmp, b->v, b->n * sizeof tmp[0]);
+    mb = median(tmp, b->n);
+    *ratio = mb / ma;
+
+    for (i = 0; i < STATS_BOOTSTRAP_N; i++) {
+        ma = resample_median(a->v, a->n, tmp);
+        mb = resample_median(b->v, b->n, tmp);
+        boot[i] = mb / ma;
+    }
+    qsort(boot, STATS_BOOTSTRAP_N, sizeof boot[0], double_cmp);
+    *lo = sorted_percentile(boot, STATS_BOOTSTRAP_N, 2.5);
+    *hi = sorted_percentile(boot, STATS_BOOTSTRAP_N, 97.5);
+
+    free(tmp);
+    free(boot);
+    return *lo > 1. + noise || *hi < 1. - noise;
+}
+
+static bool
+baseline_parse(struct baseline *b, char *line)
+{
+    struct baseline_entry e = { .samples = SAMPLES_INITIALIZER, };
+    char *key = strtok(line, " \n");
+    char *tok = strtok(NULL, " \n");
+    unsigned long int n;
+    char *end;
+
+    if (key == NULL || tok == NULL) {
+        return false;
+    }
+    n = strtoul(tok, &end, 10);
+    if (*end != '\0' || n == 0) {
+        return false;
+    }
+    while ((tok = strtok(NULL, " \n")) != NULL) {
+        samples_add(&e.samples, strtod(tok, &end));
+        if (*end != '\0') {
+            samples_destroy(&e.samples);
+            return false;
+        }
+    }
+    if (e.samples.n != n) {
+        samples_destroy(&e.samples);
+        return false;
+    }
+
+    e.key = strdup(key);
+    b->entries = realloc(b->entries, (b->n + 1) * sizeof b->entries[0]);
+    if (e.key == NULL || b->entries == NULL) {
+        out_of_memory();
+    }
+    b->entries[b->n++] = e;
+    return true;
+}
+
+bool
+baseline_load(struct baseline *b, const char *path, const char **err)
+{
+    char *line = NULL;
+    size_t size = 0;
+    bool ok = true;
+    FILE *f;
+
+    memset(b, 0, sizeof *b);
+    f = fopen(path, "r");
+    if (f == NULL) {
+        *err = strerror(errno);
+        return false;
+    }
+    while (ok && getline(&line, &size, f) != -1) {
+        ok = baseline_parse(b, line);
+    }
+    free(line);
+    fclose(f);
+
+    if (!ok) {
+        *err = "invalid baseline line";
+        baseline_destroy(b);
+    }
+    return ok;
+}
+
+struct samples *
+baseline_find(struct baseline *b, const char *key)
+{
+    for (size_t i = 0; i < b->n; i++) {
+        if (!strcmp(b->entries[i].key, key)) {
+            return &b->entries[i].samples;
+        }
+    }
+    return NULL;
+}
+
+void
+baseline_write(FILE *f, const char *key, struct samples *s)
+{
+    fprintf(f, "%s %zu", key, s->n);
+    for (size_t i = 0; i < s->n; i++) {
+        fprintf(f, " %.17g", s->v[i]);
+    }
+    fprintf(f, "\n");
+}
+
+void
+baseline_destroy(struct baseline *b)
+{
+    for (size_t i = 0; i < b->n; i++) {
+        free(b->entries[i].key);
+        samples_destroy(&b->entries[i].samples);
+    }
+    free(b->entries);
+    memset(b, 0, sizeof *b);
+}
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "mov-avg.h"
+
+/* Statistics over repeated measures.
+ *
+ * Measures are summarized by their median, with a 95% confidence
+ * interval computed by bootstrap: the median of samples drawn with
+ * replacement from the measures, sorted, gives the interval between
+ * their 2.5th and 97.5th percentiles. No distribution is assumed,
+ * timing measures being usually skewed.
+ *
+ * Outliers are measures beyond 1.5 interquartile ranges from the
+ * first or third quartile (Tukey fences).
+ *
+ * Two sets of measures are compared by the ratio of their medians,
+ * with its own bootstrap interval. The change is significant if
+ * the interval is entirely beyond a relative noise threshold.
+ *
+ * Bootstrap draws use their own generator, to leave the random
+ * sequence of the bench untouched.
+ */
+
+struct samples {
+    double *v;
+    size_t n;
+    size_t capacity;
+    /* Mean and standard deviation. */
+    struct mov_avg_cma cma;
+};
+
+#define SAMPLES_INITIALIZER { \
+    .v = NULL, .n = 0, .capacity = 0, \
+    .cma = MOV_AVG_CMA_INITIALIZER, \
+}
+
+struct samples_summary {
+    double median;
+    /* 95% confidence interval of the median. */
+    double lo;
+    double hi;
+    double mean;
+    double std_dev;
+    size_t n_outliers;
+};
+
+void samples_add(struct samples *s, double v);
+void samples_clear(struct samples *s);
+void samples_destroy(struct samples *s);
+/* 's' must hold at least one measure. */
+void samples_summarize(struct samples *s, struct samples_summary *sum);
+/* Write the ratio of the medians of 'b' over 'a' into 'ratio',
+ * with its 95% confidence interval. Returns true if the change
+ * is significant, beyond 'noise', e.g. 0.02 for 2%. */
+bool samples_compare(struct samples *a, struct samples *b, double noise,
+                     double *ratio, double *lo, double *hi);
+
+/* Baselines.
+ *
+ * A baseline file holds one line per metric of a test:
+ * its key, the number of measures then the measures,
+ * separated by spaces. Keys do not hold any space.
+ */
+
+struct baseline_entry {
+    char *key;
+    struct samples samples;
+};
+
+struct baseline {
+    struct baseline_entry *entries;
+    size_t n;
+};
+
+/* Returns false if 'path' could not be read, setting 'err'. */
+bool baseline_load(struct baseline *b, const char *path, const char **err);
+/* Returns the measures of 'key', NULL if not found. */
+struct samples *baseline_find(struct baseline *b, const char *key);
+void baseline_write(FILE *f, const char *key, struct samples *s);
+void baseline_destroy(struct baseline *b);
+
+#endif /* STATS_H */
@@ -0,0 +1,273 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "heap.h"
+
+#include "bench.h"
+#include "key.h"
+#include "sweep.h"
+
+static void
+sweep_values_add(struct sweep_values *sv, unsigned long int v)
+{
+    sv->v = realloc(sv->v, (sv->n + 1) * sizeof sv->v[0]);
+    if (sv->v == NULL) {
+        out_of_memory();
+    }
+    sv->v[sv->n++] = v;
+}
+
+static bool
+sweep_uint(const char **s, unsigned long int *v)
+{
+    char *end;
+
+    if (**s < '0' || **s > '9') {
+        return false;
+    }
+    errno = 0;
+    *v = strtoul(*s, &end, 10);
+    if (errno != 0 || *v > UINT_MAX) {
+        return false;
+    }
+    *s = end;
+    return true;
+}
+
+bool
+sweep_values_parse(const char *s, struct sweep_values *sv)
+{
+    sv->n = 0;
+
+    do {
+        unsigned long int a, b, step = 2;
+        bool mult = true;
+
+        if (!sweep_uint(&s, &a)) {
+            return false;
+        }
+        b = a;
+        if (*s == ':') {
+            s++;
+            if (!sweep_uint(&s, &b) || b < a) {
+                return false;
+            }
+            if (*s == ':') {
+                s++;
+                if (*s != 'x' && *s != '+') {
+                    return false;
+                }
+                mult = *s++ == 'x';
+                if (!sweep_uint(&s, &step)) {
+                    return false;
+                }
+            }
+            if (step < (mult ? 2 : 1)) {
+                return false;
+            }
+        }
+        for (; a <= b; a = mult ? a * step : a + step) {
+            sweep_values_add(sv, a);
+            if (a == 0 && mult) {
+                break;
+            }
+        }
+    } while (*s++ == ',');
+
+    return s[-1] == '\0';
+}
+
+bool
+sweep_format_parse(const char *s, enum sweep_format *format)
+{
+    if (!strcmp(s, "csv")) {
+        *format = SWEEP_CSV;
+    } else if (!strcmp(s, "json")) {
+        *format = SWEEP_JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Write the column 'name' of the header, or its value in a record.
+ * The value is missing if 'fmt' is NULL. */
+static void
+sweep_col(struct sweep *s, const char *name, const char *fmt, ...)
+{
+    char value[64] = "";
+    va_list args;
+
+    if (fmt != NULL) {
+        va_start(args, fmt);
+        vsnprintf(value, sizeof value, fmt, args);
+        va_end(args);
+    }
+
+    if (s->header) {
+        printf("%s%s", s->sep, name);
+    } else if (s->format == SWEEP_CSV) {
+        printf("%s%s", s->sep, value);
+    } else {
+        printf("%s\"%s\": %s", s->sep, name, fmt != NULL ? value : "null");
+    }
+    s->sep = s->format == SWEEP_CSV ? "," : ", ";
+}
+
+static void
+sweep_record(struct sweep *s, struct test *t, unsigned int rep)
+{
+    struct test_results *r = &t->results;
+    struct test_params *p = &t->params;
+    const char *phases[] = { "insert", "delete", };
+    char name[64];
+    size_t i, j;
+
+    s->sep = "";
+    if (!s->header && s->format == SWEEP_JSON) {
+        printf("  {");
+    }
+
+    sweep_col(s, "heap", s->format == SWEEP_JSON ? "\"%s\"" : "%s",
+              t->h->desc);
+    sweep_col(s, "n", "%u", p->n_elems);
+    sweep_col(s, "range", "%u", p->range);
+    sweep_col(s, "update", "%u", p->p_update);
+    sweep_col(s, "rep", "%u", rep);
+    sweep_col(s, "seed", "%u", p->seed);
+    sweep_col(s, "key", s->format == SWEEP_JSON ? "\"%s\"" : "%s",
+              key_type_name(element_key_type));
+    sweep_col(s, "cmp_cost", "%u", element_cmp_cost);
+    sweep_col(s, "insert_ns", "%.1lf", test_phase_ns(t, 0));
+    sweep_col(s, "delete_ns", "%.1lf", test_phase_ns(t, 1));
+
+    for (i = 0; i < HEAP_N_OPS; i++) {
+        struct histogram *l = &r->latency[i];
+        bool some = l->count > 0;
+
+        snprintf(name, sizeof name, "%s_count", op_desc[i]);
+        sweep_col(s, name, "%llu", l->count);
+        for (j = 0; j < TEST_N_PERCENTILES; j++) {
+            snprintf(name, sizeof name, "%s_p%g", op_desc[i], percentiles[j]);
+            sweep_col(s, name, some ? "%llu" : NULL,
+                      histogram_percentile(l, percentiles[j]));
+        }
+        snprintf(name, sizeof name, "%s_max", op_desc[i]);
+        sweep_col(s, name, some ? "%llu" : NULL, l->max);
+    }
+
+    if (s->counts) {
+        for (i = 0; i < HEAP_N_OPS; i++) {
+            struct heap_counts *c = &t->h->counts[i];
+            double ops = c->ops;
+            const char *fmt = c->ops > 0 ? "%.3lf" : NULL;
+
+            snprintf(name, sizeof name, "%s_cmp", op_desc[i]);
+            sweep_col(s, name, fmt, c->cmp / ops);
+            snprintf(name, sizeof name, "%s_link", op_desc[i]);
+            sweep_col(s, name, fmt, c->link / ops);
+            snprintf(name, sizeof name, "%s_deref", op_desc[i]);
+            sweep_col(s, name, fmt, c->deref / ops);
+            snprintf(name, sizeof name, "%s_alloc", op_desc[i]);
+            sweep_col(s, name, fmt, c->alloc / ops);
+        }
+    }
+
+    if (s->perf) {
+        for (i = 0; i < ARRAY_SIZE(phases); i++) {
+            unsigned long long int n = test_phase_ops(t, i);
+            struct perf_sample d;
+
+            perf_diff(&r->perf[i], &r->perf[i + 1], &d);
+            for (j = 0; j < PERF_N_EVENTS; j++) {
+                snprintf(name, sizeof name, "%s_%s", phases[i],
+                         perf_event_desc[j]);
+                sweep_col(s, name, d.valid[j] && n > 0 ? "%.3lf" : NULL,
+                          d.v[j] / MAX(n, 1));
+            }
+        }
+    }
+
+    if (s->memory) {
+        struct test_memory *m = &r->memory;
+
+        sweep_col(s, "bytes_per_elem", "%.1lf", test_bytes_per_elem(t, m->live));
+        sweep_col(s, "peak_bytes_per_elem", "%.1lf",
+                  test_bytes_per_elem(t, m->peak));
+        sweep_col(s, "allocs", "%llu", m->n_allocs);
+        sweep_col(s, "alloc_bytes", "%llu", m->bytes);
+        sweep_col(s, "rss_inserted", "%lld", m->rss[0]);
+        sweep_col(s, "rss_end", "%lld", m->rss[1]);
+    }
+
+    if (!s->header && s->format == SWEEP_JSON) {
+        printf("}");
+    } else {
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+void
+sweep_run(struct sweep *s, const struct test_params *base,
+          struct heap **heaps, size_t n_heaps)
+{
+    struct test t = TEST_INITIALIZER;
+    bool first = true;
+    size_t i, j, k, h;
+    unsigned int rep;
+
+    if (s->format == SWEEP_CSV) {
+        /* The header only needs the columns, from any test. */
+        s->header = true;
+        t.h = heaps[0];
+        sweep_record(s, &t, 0);
+        s->header = false;
+    } else {
+        printf("[\n");
+    }
+
+    for (i = 0; i < s->n_elems.n; i++) {
+        for (j = 0; j < s->range.n; j++) {
+            for (k = 0; k < s->p_update.n; k++) {
+                for (rep = 0; rep < s->repeat; rep++) {
+                    for (h = 0; h < n_heaps; h++) {
+                        t.h = heaps[h];
+                        t.params = *base;
+                        t.params.n_elems = s->n_elems.v[i];
+                        t.params.range = s->range.v[j];
+                        t.params.p_update = s->p_update.v[k];
+                        t.params.seed = base->seed + rep;
+                        if (t.params.p_update > 0 && t.h->update == NULL) {
+                            continue;
+                        }
+
+                        for (unsigned int w = 0; w < s->warmup; w++) {
+                            test_execute(&t);
+                        }
+                        random_init(t.params.seed);
+                        test_execute(&t);
+                        if (s->format == SWEEP_JSON && !first) {
+                            printf(",\n");
+                        }
+                        sweep_record(s, &t, rep);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+
+    if (s->format == SWEEP_JSON) {
+        printf("%s]\n", first ? "" : "\n");
+    }
+}
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bench.h"
+
+/* Parameter sweeps.
+ *
+ * A sweep runs the test of the bench over the cross product of the
+ * values given for the number of elements, the range of priorities
+ * and the percentage of updates, for each selected heap, a number
+ * of times. Each repetition uses the next seed, the same for all heaps.
+ *
+ * Each test is written as a record holding all its metrics, either
+ * as a CSV line after a header, or as a JSON object within an array.
+ * Missing metrics are left empty in CSV and null in JSON.
+ */
+
+/* Values taken by a parameter. */
+struct sweep_values {
+    unsigned int *v;
+    size_t n;
+};
+
+enum sweep_format {
+    SWEEP_CSV,
+    SWEEP_JSON,
+};
+
+struct sweep {
+    enum sweep_format format;
+    struct sweep_values n_elems;
+    struct sweep_values range;
+    struct sweep_values p_update;
+    unsigned int repeat;
+    /* Runs of each test before measuring it. */
+    unsigned int warmup;
+    /* Heaps are counted, report their work. */
+    bool counts;
+    /* Hardware counters are read. */
+    bool perf;
+    /* Memory is measured. */
+    bool memory;
+    /* Output state. */
+    bool header;
+    const char *sep;
+};
+
+/* Parse a comma-separated list of values or ranges into 'sv':
+ * 'a', 'a:b' doubling from 'a' up to 'b', 'a:b:xK' multiplying
+ * by K and 'a:b:+K' adding K. Returns false if it is invalid. */
+bool sweep_values_parse(const char *s, struct sweep_values *sv);
+bool sweep_format_parse(const char *s, enum sweep_format *format);
+/* Run the sweep 's' over 'heaps', starting from 'base'. */
+void sweep_run(struct sweep *s, const struct test_params *base,
+               struct heap **heaps, size_t n_heaps);
+
+#endif /* SWEEP_H */
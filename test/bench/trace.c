@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+bool
+trace_writer_open(struct trace_writer *w, const char *path,
+                  uint32_t n_elems, uint32_t p_update, uint32_t p_shed)
+{
+    memset(&w->hdr, 0, sizeof w->hdr);
+    memcpy(w->hdr.magic, TRACE_MAGIC, sizeof TRACE_MAGIC);
+    w->hdr.version = TRACE_VERSION;
+    w->hdr.n_elems = n_elems;
+    w->hdr.p_update = p_update;
+    w->hdr.p_shed = p_shed;
+
+    w->f = fopen(path, "wb");
+    if (w->f == NULL) {
+        return false;
+    }
+    /* Reserve the header, written once complete. */
+    if (fwrite(&w->hdr, sizeof w->hdr, 1, w->f) != 1) {
+        fclose(w->f);
+        w->f = NULL;
+        return false;
+    }
+    return true;
+}
+
+void
+trace_write(struct trace_writer *w, enum trace_op_type type,
+            uint32_t id, int64_t key)
+{
+    struct trace_op op = {
+        .type = type,
+        .id = id,
+        .key = key,
+    };
+
+    /* Errors are kept by the stream until closing. */
+    fwrite(&op, sizeof op, 1, w->f);
+    w->hdr.op_types |= 1u << type;
+    w->hdr.n_ops++;
+}
+
+bool
+trace_writer_close(struct trace_writer *w)
+{
+    bool ok;
+
+    ok = !ferror(w->f) && fseek(w->f, 0, SEEK_SET) == 0 &&
+         fwrite(&w->hdr, sizeof w->hdr, 1, w->f) == 1;
+    ok = (fclose(w->f) == 0) && ok;
+    w->f = NULL;
+    return ok;
+}
+
+static const char *
+trace_check(struct trace *t)
+{
+    struct trace_header *hdr = t->hdr;
+
+    if (t->size < sizeof *hdr ||
+        memcmp(hdr->magic, TRACE_MAGIC, sizeof TRACE_MAGIC)) {
+        return "not a trace file";
+    }
+    if (hdr->version != TRACE_VERSION) {
+        return "unsupported trace version";
+    }
+    if ((t->size - sizeof *hdr) / sizeof t->ops[0] != hdr->n_ops ||
+        (t->size - sizeof *hdr) % sizeof t->ops[0] != 0) {
+        return "truncated trace";
+    }
+    for (uint64_t i = 0; i < hdr->n_ops; i++) {
+        if (t->ops[i].type >= TRACE_N_OP_TYPES ||
+            t->ops[i].id >= hdr->n_elems) {
+            return "invalid operation in trace";
+        }
+    }
+    return NULL;
+}
+
+bool
+trace_map(struct trace *t, const char *path, const char **err)
+{
+    int flags = MAP_PRIVATE;
+    struct stat st;
+    void *p;
+    int fd;
+
+#ifdef MAP_POPULATE
+    /* Fault all pages in now rather than during the replay. */
+    flags |= MAP_POPULATE;
+#endif
+
+    memset(t, 0, sizeof *t);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        *err = strerror(errno);
+        return false;
+    }
+    if (fstat(fd, &st) < 0) {
+        *err = strerror(errno);
+        close(fd);
+        return false;
+    }
+    if ((size_t) st.st_size < sizeof *t->hdr) {
+        *err = "not a trace file";
+        close(fd);
+        return false;
+    }
+
+    p = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        *err = strerror(errno);
+        return false;
+    }
+
+    t->hdr = p;
+    t->ops = (struct trace_op *) (t->hdr + 1);
+    t->size = st.st_size;
+    *err = trace_check(t);
+    if (*err != NULL) {
+        trace_unmap(t);
+        return false;
+    }
+    return true;
+}
+
+void
+trace_unmap(struct trace *t)
+{
+    if (t->hdr != NULL) {
+        munmap(t->hdr, t->size);
+    }
+    memset(t, 0, sizeof *t);
+}
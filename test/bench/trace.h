@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Operation traces.
+ *
+ * A trace is the stream of operations applied to a heap, recorded to
+ * be replayed identically against any other. Elements are identified
+ * by their index within [0, n_elems).
+ *
+ * The file is a header followed by fixed-size records, in host byte
+ * order. Once mapped in memory, records are read in place: there is
+ * no parsing during a replay. Traces from other programs can be
+ * written in the same format.
+ */
+
+#define TRACE_MAGIC "HEAPTRC"
+#define TRACE_VERSION 1
+
+enum trace_op_type {
+    TRACE_INSERT,
+    TRACE_POP,
+    TRACE_POP_MAX,
+    TRACE_UPDATE,
+    TRACE_N_OP_TYPES,
+};
+
+struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_elems;
+    uint64_t n_ops;
+    /* Bitmask of the operation types used, (1 << type). */
+    uint32_t op_types;
+    /* Parameters of the recorded benchmark, 0 if unknown. */
+    uint32_t p_update;
+    uint32_t p_shed;
+    uint32_t pad;
+};
+
+struct trace_op {
+    uint32_t type;
+    uint32_t id;
+    /* New priority of the element for insert and update,
+     * the priority of the removed one otherwise. */
+    int64_t key;
+};
+
+struct trace_writer {
+    FILE *f;
+    struct trace_header hdr;
+};
+
+/* Start recording a trace into 'path'. Returns false on error,
+ * with errno set. */
+bool trace_writer_open(struct trace_writer *w, const char *path,
+                       uint32_t n_elems, uint32_t p_update, uint32_t p_shed);
+void trace_write(struct trace_writer *w, enum trace_op_type type,
+                 uint32_t id, int64_t key);
+/* Write the final header and close the file. Returns false on error. */
+bool trace_writer_close(struct trace_writer *w);
+
+struct trace {
+    struct trace_header *hdr;
+    struct trace_op *ops;
+    size_t size;
+};
+
+/* Map the trace in 'path' and check it. Returns false on error,
+ * with an error message in 'err'. */
+bool trace_map(struct trace *t, const char *path, const char **err);
+void trace_unmap(struct trace *t);
+
+#endif /* TRACE_H */
@@ -0,0 +1,396 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+#include "heap.h"
+#include "timer.h"
+
+#include "bench.h"
+#include "graph.h"
+
+/* Classic priority queue workloads, each one run against every heap
+ * on the same inputs: graphs are built once, and random draws made
+ * during a run start again from the same seed for each heap.
+ *
+ * All heaps are min-heaps. The result of a run is a checksum
+ * of its output, which must be the same for all heaps, except for
+ * the simulation where ties can change the order of events. */
+
+/* Scale of the priority increments. */
+#define WL_MEAN (1 << 16)
+
+enum wl_dist {
+    WL_EXPONENTIAL,
+    WL_UNIFORM,
+    WL_BIMODAL,
+    WL_TRIANGULAR,
+};
+
+enum wl_graph {
+    WL_RANDOM,
+    WL_GRID,
+};
+
+struct workload {
+    const char *name;
+    const char *desc;
+    void (*init)(const struct workload *w, struct test_params *p);
+    void (*run)(const struct workload *w, struct heap *h,
+                struct workload_result *r);
+    /* Distribution or graph used. */
+    int arg;
+    bool needs_update;
+};
+
+static struct test_params wl_params;
+
+/* Uniform draw within (0, 1]. */
+static double
+wl_uniform(void)
+{
+    return (random_u32() + 1.) / 4294967296.;
+}
+
+static long long int
+wl_increment(enum wl_dist d)
+{
+    switch (d) {
+    case WL_EXPONENTIAL:
+        return -log(wl_uniform()) * WL_MEAN;
+    case WL_UNIFORM:
+        return wl_uniform() * 2 * WL_MEAN;
+    case WL_BIMODAL:
+        /* Mostly short increments, with a few very long ones,
+         * for a mean of WL_MEAN. */
+        if (random_u32_range(10) != 0) {
+            return wl_uniform() * .2 * WL_MEAN;
+        }
+        return (8.2 + wl_uniform() * 1.8) * WL_MEAN;
+    case WL_TRIANGULAR:
+        return (wl_uniform() + wl_uniform()) * WL_MEAN;
+    }
+    return WL_MEAN;
+}
+
+static void
+wl_no_init(const struct workload *w, struct test_params *p)
+{
+    (void) w;
+    wl_params = *p;
+}
+
+/* Hold model: the heap keeps 'n' elements, each hold removing the
+ * first one and inserting it back with its priority increased. */
+static void
+wl_hold(const struct workload *w, struct heap *h, struct workload_result *r)
+{
+    unsigned int n = wl_params.n_elems;
+    struct element *elems;
+    struct element *e;
+    size_t i;
+
+    elems = xcalloc(n, sizeof elems[0]);
+    for (i = 0; i < n; i++) {
+        elems[i].priority = wl_increment(w->arg);
+    }
+
+    heap_init(h);
+    r->start = timer_start();
+    for (i = 0; i < n; i++) {
+        heap_insert(h, &elems[i]);
+    }
+    for (i = 0; i < 10 * (size_t) n; i++) {
+        e = heap_pop(h);
+        r->result += e->priority;
+        e->priority += wl_increment(w->arg);
+        heap_insert(h, e);
+    }
+    while (heap_pop(h) != NULL) {
+    }
+    r->end = timer_stop();
+    r->n_ops = 2 * (unsigned long long int) n + 20 * (size_t) n;
+
+    free(elems);
+}
+
+/* Heapsort: insert all elements, then remove them in order. */
+static void
+wl_heapsort(const struct workload *w, struct heap *h,
+            struct workload_result *r)
+{
+    unsigned int n = wl_params.n_elems;
+    struct element *elems;
+    struct element *e;
+    long long int last;
+    size_t i;
+
+    (void) w;
+    elems = xcalloc(n, sizeof elems[0]);
+    for (i = 0; i < n; i++) {
+        elems[i].priority = random_u32_range(wl_params.range);
+    }
+
+    heap_init(h);
+    r->start = timer_start();
+    for (i = 0; i < n; i++) {
+        heap_insert(h, &elems[i]);
+    }
+    last = LLONG_MIN;
+    while ((e = heap_pop(h)) != NULL) {
+        if (e->priority < last) {
+            fprintf(stderr, "%s: heapsort output is not sorted.\n", h->desc);
+            abort();
+        }
+        last = e->priority;
+        r->result = r->result * 31 + e->priority;
+    }
+    r->end = timer_stop();
+    r->n_ops = 2 * (unsigned long long int) n;
+
+    free(elems);
+}
+
+/* Discrete-event simulation: each entity has one pending event.
+ * Processing an event schedules the next one of its entity, and
+ * sometimes postpones the pending event of another entity. */
+static void
+wl_simulation(const struct workload *w, struct heap *h,
+              struct workload_result *r)
+{
+    unsigned int n = wl_params.n_elems;
+    struct element *elems;
+    struct element *e;
+    long long int now = 0;
+    size_t i;
+
+    (void) w;
+    elems = xcalloc(n, sizeof elems[0]);
+    for (i = 0; i < n; i++) {
+        elems[i].priority = wl_increment(WL_EXPONENTIAL);
+    }
+
+    heap_init(h);
+    r->start = timer_start();
+    for (i = 0; i < n; i++) {
+        heap_insert(h, &elems[i]);
+    }
+    r->n_ops = n;
+    for (i = 0; i < 10 * (size_t) n; i++) {
+        e = heap_pop(h);
+        now = e->priority;
+        e->priority = now + wl_increment(WL_EXPONENTIAL);
+        heap_insert(h, e);
+        r->n_ops += 2;
+
+        if (h->update != NULL && random_u32_range(10) == 0) {
+            struct element *o = &elems[random_u32_range(n)];
+
+            heap_update_key(h, o, o->priority + wl_increment(WL_UNIFORM));
+            r->n_ops += 1;
+        }
+    }
+    while (heap_pop(h) != NULL) {
+        r->n_ops += 1;
+    }
+    r->end = timer_stop();
+    r->result = now;
+
+    free(elems);
+}
+
+static struct graph wl_graph;
+
+static uint32_t
+wl_weight(void)
+{
+    return 1 + random_u32_range(1000);
+}
+
+static void
+wl_graph_init(const struct workload *w, struct test_params *p)
+{
+    struct graph_arc *arcs;
+    size_t n, m = 0;
+    uint32_t i;
+
+    wl_params = *p;
+    n = MAX(p->n_elems, 2);
+
+    if (w->arg == WL_GRID) {
+        size_t side = ceil(sqrt(n));
+
+        n = side * side;
+        arcs = xcalloc(2 * n, sizeof arcs[0]);
+        for (i = 0; i < n; i++) {
+            if ((i + 1) % side != 0) {
+                arcs[m++] = (struct graph_arc) { i, i + 1, wl_weight() };
+            }
+            if (i + side < n) {
+                arcs[m++] = (struct graph_arc) { i, i + side, wl_weight() };
+            }
+        }
+    } else {
+        /* A ring keeps the graph connected,
+         * with three random edges per vertex. */
+        arcs = xcalloc(4 * n, sizeof arcs[0]);
+        for (i = 0; i < n; i++) {
+            arcs[m++] = (struct graph_arc) { i, (i + 1) % n, wl_weight() };
+        }
+        for (i = 0; i < 3 * n; i++) {
+            arcs[m++] = (struct graph_arc) {
+                random_u32_range(n), random_u32_range(n), wl_weight(),
+            };
+        }
+    }
+
+    graph_build(&wl_graph, n, arcs, m, true);
+    free(arcs);
+}
+
+/* Dijkstra shortest paths from vertex 0 when 'mst' is false,
+ * Prim minimum spanning tree otherwise. The result is the sum
+ * of the distances, or the weight of the tree. Both rely
+ * on decrease-key. */
+static void
+wl_graph_search(struct heap *h, struct workload_result *r, bool mst)
+{
+    struct element *v;
+    struct element *e;
+    bool *settled;
+    size_t i;
+
+    v = xcalloc(wl_graph.n, sizeof v[0]);
+    settled = xcalloc(wl_graph.n, sizeof settled[0]);
+
+    heap_init(h);
+    r->start = timer_start();
+    v[0].priority = 0;
+    heap_insert(h, &v[0]);
+    r->n_ops = 1;
+    while ((e = heap_pop(h)) != NULL) {
+        size_t u = e - v;
+
+        r->n_ops++;
+        settled[u] = true;
+        r->result += e->priority;
+        for (i = wl_graph.first[u]; i < wl_graph.first[u + 1]; i++) {
+            size_t x = wl_graph.dst[i];
+            long long int d = wl_graph.weight[i];
+
+            if (settled[x]) {
+                continue;
+            }
+            if (!mst) {
+                d += e->priority;
+            }
+            if (!v[x].inserted) {
+                v[x].priority = d;
+                heap_insert(h, &v[x]);
+                r->n_ops++;
+            } else if (d < v[x].priority) {
+                heap_update_key(h, &v[x], d);
+                r->n_ops++;
+            }
+        }
+    }
+    r->end = timer_stop();
+
+    free(settled);
+    free(v);
+}
+
+static void
+wl_dijkstra(const struct workload *w, struct heap *h,
+            struct workload_result *r)
+{
+    (void) w;
+    wl_graph_search(h, r, false);
+}
+
+static void
+wl_prim(const struct workload *w, struct heap *h, struct workload_result *r)
+{
+    (void) w;
+    wl_graph_search(h, r, true);
+}
+
+static const struct workload workloads[] = {
+    { "hold-exp", "hold model, exponential increments",
+      wl_no_init, wl_hold, WL_EXPONENTIAL, false, },
+    { "hold-uniform", "hold model, uniform increments",
+      wl_no_init, wl_hold, WL_UNIFORM, false, },
+    { "hold-bimodal", "hold model, bimodal increments",
+      wl_no_init, wl_hold, WL_BIMODAL, false, },
+    { "hold-triangular", "hold model, triangular increments",
+      wl_no_init, wl_hold, WL_TRIANGULAR, false, },
+    { "dijkstra-random", "shortest paths, random graph",
+      wl_graph_init, wl_dijkstra, WL_RANDOM, true, },
+    { "dijkstra-grid", "shortest paths, grid graph",
+      wl_graph_init, wl_dijkstra, WL_GRID, true, },
+    { "prim-random", "minimum spanning tree, random graph",
+      wl_graph_init, wl_prim, WL_RANDOM, true, },
+    { "prim-grid", "minimum spanning tree, grid graph",
+      wl_graph_init, wl_prim, WL_GRID, true, },
+    { "simulation", "discrete-event simulation, with postponed events",
+      wl_no_init, wl_simulation, 0, false, },
+    { "heapsort", "insert all, then remove all",
+      wl_no_init, wl_heapsort, 0, false, },
+};
+
+const struct workload *
+workload_find(const char *name)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(workloads); i++) {
+        if (!strcmp(workloads[i].name, name)) {
+            return &workloads[i];
+        }
+    }
+    return NULL;
+}
+
+void
+workload_list(FILE *s)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(workloads); i++) {
+        fprintf(s, "  %-16s %s\n", workloads[i].name, workloads[i].desc);
+    }
+}
+
+const char *
+workload_desc(const struct workload *w)
+{
+    return w->desc;
+}
+
+void
+workload_init(const struct workload *w, struct test_params *params)
+{
+    w->init(w, params);
+}
+
+bool
+workload_run(const struct workload *w, struct heap *h,
+             struct workload_result *r)
+{
+    if (w->needs_update && h->update == NULL) {
+        return false;
+    }
+
+    memset(r, 0, sizeof *r);
+    random_init(wl_params.seed);
+    w->run(w, h, r);
+    return true;
+}
+
+void
+workload_finish(const struct workload *w)
+{
+    (void) w;
+    graph_destroy(&wl_graph);
+}
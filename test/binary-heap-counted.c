@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* The same heap, built with its instrumentation enabled. */
+
+#define HEAP_COUNTING
+
+#define min_binary_heap min_binary_heap_counted
+#define max_binary_heap max_binary_heap_counted
+
+#include "binary-heap.c"
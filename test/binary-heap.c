@@ -9,6 +9,12 @@
 #include "binary-heap.h"
 #include "util.h"
 
+/* This file is also built with other layouts of the heap,
+ * see 'paged-binary-heap.c'. */
+#ifndef BINARY_HEAP_DESC
+#define BINARY_HEAP_DESC "binary-heap"
+#endif
+
 static int
 min_node_cmp(struct bheap_node *a, struct bheap_node *b)
 {
@@ -21,6 +27,19 @@ max_node_cmp(struct bheap_node *a, struct bheap_node *b)
     return -min_node_cmp(a, b);
 }
 
+static int
+min_node_key_cmp(struct bheap_node *a, struct bheap_node *b)
+{
+    return min_element_key_cmp(a->priority.lli, b->priority.lli,
+                               a->data, b->data);
+}
+
+static int
+max_node_key_cmp(struct bheap_node *a, struct bheap_node *b)
+{
+    return -min_node_key_cmp(a, b);
+}
+
 static void
 binary_heap_init(void *aux, void *cmp)
 {
@@ -68,52 +87,68 @@ binary_heap_update(void *heap, struct element *e, long long int v)
     bheap_update_key(heap, k);
 }
 
-#define LEFT(i) (2 * i + 1)
-#define RIGHT(i) (2 * i + 2)
-#define PARENT(i) ((i - 1) / 2)
-
-static bool
-is_heap(struct bheap_node *h, size_t n, bheap_cmp cmp)
+static size_t
+binary_heap_peek_k(void *heap, size_t k, struct element *out[])
 {
-    size_t i;
+    struct bheap_node *nodes = xmalloc(k * sizeof nodes[0]);
+    size_t i, n;
 
+    n = bheap_peek_k(heap, k, nodes);
     for (i = 0; i < n; i++) {
-        if (LEFT(i) >= n)
-            break;
-        if (cmp(&h[i], &h[LEFT(i)]) > 0) {
-            struct element *e[2] = { h[i].data, h[LEFT(i)].data };
-
-            printf("size=%zu, failing on "
-                   "node %zu (%lld) > (L) %zu (%lld)\n",
-                   n, i, e[0]->priority, LEFT(i), e[1]->priority);
-            abort();
-        }
-        if (RIGHT(i) >= n)
-            break;
-        if (cmp(&h[i], &h[RIGHT(i)]) > 0) {
-            struct element *e[2] = { h[i].data, h[RIGHT(i)].data };
-
-            printf("size=%zu, failing on "
-                   "node %zu (%lld) > (R) %zu (%lld)\n",
-                   n, i, e[0]->priority, LEFT(i), e[1]->priority);
-            abort();
-        }
+        out[i] = nodes[i].data;
+    }
+    free(nodes);
+    return n;
+}
+
+/* The layout of the array is given by the header,
+ * use its navigation functions to check the tree. */
+
+static void
+check_child(struct bheap *h, size_t i, size_t child, const char *side)
+{
+    struct bheap_node *n = h->entries;
+
+    if (h->cmp(&n[i], &n[child]) > 0) {
+        struct element *e[2] = { n[i].data, n[child].data };
+
+        printf("size=%zu, failing on "
+               "node %zu (%lld) > (%s) %zu (%lld)\n",
+               h->n, i, e[0]->priority, side, child, e[1]->priority);
+        abort();
+    }
+}
+
+static bool
+is_heap(struct bheap *h)
+{
+    size_t end = bheap_index(h->n);
+    size_t k, i, left, right;
+
+    for (k = 0, i = BHEAP_ROOT; k < h->n; k++, i = bheap_next(i)) {
+        left = bheap_left(i);
+        if (left >= end)
+            continue;
+        check_child(h, i, left, "L");
+        right = bheap_right(i, left);
+        if (right >= end)
+            continue;
+        check_child(h, i, right, "R");
     }
     return true;
 }
 
-void
+static void
 binary_heap_validate(void *_h)
 {
-    struct bheap *h = _h;
-
-    is_heap(h->entries, h->n, h->cmp);
+    is_heap(_h);
 }
 
 static struct bheap heap;
 
 struct heap min_binary_heap = {
     .heap = &heap,
+    .heap_size = sizeof heap,
     .cmp = min_node_cmp,
     .init = binary_heap_init,
     .is_empty = binary_heap_is_empty,
@@ -122,11 +157,16 @@ struct heap min_binary_heap = {
     .pop = binary_heap_pop,
     .update = binary_heap_update,
     .validate = binary_heap_validate,
-    .desc = "min-binary-heap",
+    .counts = HEAP_OP_COUNTS,
+    .node_size = 0,
+    .key_cmp = min_node_key_cmp,
+    .peek_k = binary_heap_peek_k,
+    .desc = "min-" BINARY_HEAP_DESC,
 };
 
 struct heap max_binary_heap = {
     .heap = &heap,
+    .heap_size = sizeof heap,
     .cmp = max_node_cmp,
     .init = binary_heap_init,
     .is_empty = binary_heap_is_empty,
@@ -135,5 +175,9 @@ struct heap max_binary_heap = {
     .pop = binary_heap_pop,
     .update = binary_heap_update,
     .validate = binary_heap_validate,
-    .desc = "max-binary-heap",
+    .counts = HEAP_OP_COUNTS,
+    .node_size = 0,
+    .key_cmp = max_node_key_cmp,
+    .peek_k = binary_heap_peek_k,
+    .desc = "max-" BINARY_HEAP_DESC,
 };
@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* The same heap, built with its instrumentation enabled. */
+
+#define HEAP_COUNTING
+
+#define min_calendar_queue min_calendar_queue_counted
+#define max_calendar_queue max_calendar_queue_counted
+
+#include "calendar-queue.c"
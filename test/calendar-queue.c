@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <assert.h>
+
+#include "heap.h"
+
+#include "calendar-queue.h"
+#include "util.h"
+
+/* The calendar queue orders integer priorities and always
+ * returns the lowest first. The max variant is obtained by
+ * complementing the element priority: ~p is -p - 1, reversing
+ * the order without overflowing on LLONG_MIN. */
+
+typedef long long int (*element_key_fn)(struct element *e);
+
+struct calendar_queue {
+    struct cqueue q;
+    element_key_fn key;
+};
+
+static long long int
+min_element_key(struct element *e)
+{
+    return e->priority;
+}
+
+static long long int
+max_element_key(struct element *e)
+{
+    return ~e->priority;
+}
+
+static void
+calendar_queue_init(void *heap, void *key)
+{
+    struct calendar_queue *cq = heap;
+
+    cqueue_init(&cq->q);
+    cq->key = key;
+}
+
+static bool
+calendar_queue_is_empty(void *heap)
+{
+    struct calendar_queue *cq = heap;
+
+    return cqueue_is_empty(&cq->q);
+}
+
+static void
+calendar_queue_insert(void *heap, struct element *e)
+{
+    struct calendar_queue *cq = heap;
+
+    cqueue_insert(&cq->q, &e->cnode, cq->key(e));
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static struct element *
+calendar_queue_peek(void *heap)
+{
+    struct calendar_queue *cq = heap;
+    struct cqueue_node *n;
+
+    n = cqueue_peek(&cq->q);
+    if (n != NULL) {
+        return container_of(n, struct element, cnode);
+    } else {
+        return NULL;
+    }
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static struct element *
+calendar_queue_pop(void *heap)
+{
+    struct calendar_queue *cq = heap;
+    struct cqueue_node *n;
+
+    n = cqueue_pop(&cq->q);
+    if (n != NULL) {
+        return container_of(n, struct element, cnode);
+    } else {
+        return NULL;
+    }
+}
+
+static void
+calendar_queue_update(void *heap, struct element *e, long long int v)
+{
+    struct calendar_queue *cq = heap;
+
+    (void) v;
+    cqueue_update_key(&cq->q, &e->cnode, cq->key(e));
+}
+
+static void
+calendar_queue_validate(void *heap)
+{
+    struct calendar_queue *cq = heap;
+    struct cqueue *h = &cq->q;
+    struct cqueue_node *n;
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < h->n_buckets; i++) {
+        for (n = h->buckets[i]; n != NULL; n = n->next) {
+            long long int day = cqueue_day(h, n->prio);
+
+            assert("Element stored in the wrong bucket." &&
+                   cqueue_bucket(h, day) == i);
+            assert("Element before the current day." && day >= h->day);
+            assert("Bucket is not sorted." &&
+                   (n->next == NULL || n->prio <= n->next->prio));
+            assert("Broken bucket list." &&
+                   (n->next == NULL || n->next->prev == n));
+            count++;
+        }
+    }
+    assert("Unexpected number of elements." && count == h->n);
+}
+
+static struct calendar_queue heap;
+
+struct heap min_calendar_queue = {
+    .heap = &heap,
+    .heap_size = sizeof heap,
+    .cmp = min_element_key,
+    .init = calendar_queue_init,
+    .is_empty = calendar_queue_is_empty,
+    .insert = calendar_queue_insert,
+    .peek = calendar_queue_peek,
+    .pop = calendar_queue_pop,
+    .update = calendar_queue_update,
+    .validate = calendar_queue_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(struct cqueue_node),
+    .key_cmp = NULL,
+    .desc = "min-calendar-queue",
+};
+
+struct heap max_calendar_queue = {
+    .heap = &heap,
+    .heap_size = sizeof heap,
+    .cmp = max_element_key,
+    .init = calendar_queue_init,
+    .is_empty = calendar_queue_is_empty,
+    .insert = calendar_queue_insert,
+    .peek = calendar_queue_peek,
+    .pop = calendar_queue_pop,
+    .update = calendar_queue_update,
+    .validate = calendar_queue_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(struct cqueue_node),
+    .key_cmp = NULL,
+    .desc = "max-calendar-queue",
+};
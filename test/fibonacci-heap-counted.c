@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* The same heap, built with its instrumentation enabled. */
+
+#define HEAP_COUNTING
+
+#define min_fibonacci_heap min_fibonacci_heap_counted
+#define max_fibonacci_heap max_fibonacci_heap_counted
+
+#include "fibonacci-heap.c"
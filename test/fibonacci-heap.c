@@ -28,6 +28,24 @@ max_node_cmp(struct fheap_node *a, struct fheap_node *b)
     return -min_node_cmp(a, b);
 }
 
+ALLOW_UNDEFINED_BEHAVIOR
+static int
+min_node_key_cmp(struct fheap_node *a, struct fheap_node *b)
+{
+    struct element *e[2] = {
+        container_of(a, struct element, fnode),
+        container_of(b, struct element, fnode),
+    };
+
+    return min_element_key_cmp(e[0]->priority, e[1]->priority, e[0], e[1]);
+}
+
+static int
+max_node_key_cmp(struct fheap_node *a, struct fheap_node *b)
+{
+    return -min_node_key_cmp(a, b);
+}
+
 static void
 fibonacci_heap_init(void *heap, void *cmp)
 {
@@ -74,6 +92,21 @@ fibonacci_heap_pop(void *heap)
     }
 }
 
+ALLOW_UNDEFINED_BEHAVIOR
+static size_t
+fibonacci_heap_peek_k(void *heap, size_t k, struct element *out[])
+{
+    struct fheap_node **nodes = xmalloc(k * sizeof nodes[0]);
+    size_t i, n;
+
+    n = fheap_peek_k(heap, k, nodes);
+    for (i = 0; i < n; i++) {
+        out[i] = container_of(nodes[i], struct element, fnode);
+    }
+    free(nodes);
+    return n;
+}
+
 static void
 fibonacci_heap_update(void *heap, struct element *e, long long int v)
 {
@@ -81,53 +114,46 @@ fibonacci_heap_update(void *heap, struct element *e, long long int v)
     fheap_update_key(heap, &e->fnode);
 }
 
+/* Walk the whole heap in pre-order, following parent pointers
+ * back up, to avoid depending on the shape of the trees. */
 static void
 fibonacci_heap_validate(void *_h)
 {
-    struct fheap_node *stack[64];
     struct fheap *h = _h;
-    int c = -1;
+    struct fheap_node *n;
 
     if (h->root == NULL) {
         return;
     }
 
-    stack[++c] = h->root;
-    while (c >= 0) {
-        struct fheap_node *n, *s;
-
-//#define PRINT_FIB
-
-        s = stack[c--];
-#ifdef PRINT_FIB
-        printf("[0x%03lx:%d] ",
-                (intptr_t) s->parent & 0xfff, s->parent ? s->parent->rank : 0);
-#endif
-        FHEAP_NODE_FOREACH_PEER (n, s) {
-            struct fheap_node *child;
+    FHEAP_NODE_FOREACH_PEER (n, h->root) {
+        assert("Heap root is not the first of its level." &&
+               fheap_prop(h, h->root, n));
+    }
 
-#ifdef PRINT_FIB
-            printf("0x%03lx:%d ", (intptr_t) n & 0xfff, n->rank);
-#endif
+    n = h->root;
+    while (n != NULL) {
+        struct fheap_node *child;
+        int rank = 0;
 
+        FHEAP_NODE_FOREACH_CHILD (child, n) {
+            assert(child->parent == n);
             assert("Heap invariant not respected between parent / child." &&
-                   fheap_prop(h, s, n));
-
-            if (n->child) {
-                assert("Heap invariant not respected between parent / child." &&
-                       fheap_prop(h, n, n->child));
-                stack[++c] = n->child;
-            }
-
-            FHEAP_NODE_FOREACH_CHILD (child, n) {
-                assert(child->parent == n);
-            }
+                   fheap_prop(h, n, child));
+            rank++;
+        }
+        assert("Node rank does not match its children." && rank == n->rank);
 
-            assert("Fibonacci structure not respected." && c <= 64);
+        if (n->child != NULL) {
+            n = n->child;
+            continue;
+        }
+        while (n != NULL && n->next == NULL) {
+            n = n->parent;
+        }
+        if (n != NULL) {
+            n = n->next;
         }
-#ifdef PRINT_FIB
-        printf("\n");
-#endif
     }
 }
 
@@ -135,6 +161,7 @@ static struct fheap heap;
 
 struct heap min_fibonacci_heap = {
     .heap = &heap,
+    .heap_size = sizeof heap,
     .cmp = min_node_cmp,
     .init = fibonacci_heap_init,
     .is_empty = fibonacci_heap_is_empty,
@@ -143,11 +170,16 @@ struct heap min_fibonacci_heap = {
     .pop = fibonacci_heap_pop,
     .update = fibonacci_heap_update,
     .validate = fibonacci_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(struct fheap_node),
+    .key_cmp = min_node_key_cmp,
+    .peek_k = fibonacci_heap_peek_k,
     .desc = "min-fibonacci-heap",
 };
 
 struct heap max_fibonacci_heap = {
     .heap = &heap,
+    .heap_size = sizeof heap,
     .cmp = max_node_cmp,
     .init = fibonacci_heap_init,
     .is_empty = fibonacci_heap_is_empty,
@@ -156,5 +188,9 @@ struct heap max_fibonacci_heap = {
     .pop = fibonacci_heap_pop,
     .update = fibonacci_heap_update,
     .validate = fibonacci_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(struct fheap_node),
+    .key_cmp = max_node_key_cmp,
+    .peek_k = fibonacci_heap_peek_k,
     .desc = "min-fibonacci-heap",
 };
@@ -4,27 +4,75 @@
 
 #include "heap.h"
 
-unsigned int n_cmp;
-static bool cmp_count_enabled;
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+_Thread_local struct heap_counts heap_counts;
+
+enum element_key_type element_key_type = ELEMENT_KEY_64;
+unsigned int element_cmp_cost;
 
 void
-n_cmp_inc(void)
+heap_counts_reset(void)
 {
-    if (cmp_count_enabled) {
-        n_cmp++;
-    }
+    memset(&heap_counts, 0, sizeof heap_counts);
 }
 
 void
-n_cmp_reset(void)
+heap_op_counts_reset(struct heap *h)
+{
+    if (h->counts != NULL) {
+        memset(h->counts, 0, HEAP_N_OPS * sizeof h->counts[0]);
+    }
+}
+
+static void
+heap_op_start(struct heap *h, struct heap_counts *start)
+{
+    if (h->counts != NULL) {
+        *start = heap_counts;
+    }
+}
+
+/* Add the work done since 'start' to the counts of 'op'. */
+static void
+heap_op_count(struct heap *h, enum heap_op op, struct heap_counts *start)
 {
-    n_cmp = 0;
+    struct heap_counts *c;
+
+    if (h->counts == NULL) {
+        return;
+    }
+
+    c = &h->counts[op];
+    c->ops += 1;
+    c->cmp += heap_counts.cmp - start->cmp;
+    c->link += heap_counts.link - start->link;
+    c->deref += heap_counts.deref - start->deref;
+    c->alloc += heap_counts.alloc - start->alloc;
+}
+
+struct heap *
+heap_create(const struct heap *h)
+{
+    struct heap *copy = xmalloc(sizeof *copy);
+
+    *copy = *h;
+    copy->heap = xzalloc(h->heap_size);
+    if (h->counts != NULL) {
+        copy->counts = xcalloc(HEAP_N_OPS, sizeof copy->counts[0]);
+    }
+    return copy;
 }
 
 void
-n_cmp_enable(bool enabled)
+heap_destroy(struct heap *h)
 {
-    cmp_count_enabled = enabled;
+    free(h->counts);
+    free(h->heap);
+    free(h);
 }
 
 void
@@ -33,6 +81,12 @@ heap_init(struct heap *h)
     h->init(h->heap, h->cmp);
 }
 
+void
+heap_init_keys(struct heap *h)
+{
+    h->init(h->heap, h->key_cmp);
+}
+
 bool
 heap_is_empty(struct heap *h)
 {
@@ -42,7 +96,11 @@ heap_is_empty(struct heap *h)
 void
 heap_insert(struct heap *h, struct element *e)
 {
+    struct heap_counts start;
+
+    heap_op_start(h, &start);
     h->insert(h->heap, e);
+    heap_op_count(h, HEAP_OP_INSERT, &start);
     e->inserted = true;
 }
 
@@ -55,8 +113,33 @@ heap_peek(struct heap *h)
 struct element *
 heap_pop(struct heap *h)
 {
-    struct element *e = h->pop(h->heap);
+    struct heap_counts start;
+    struct element *e;
 
+    heap_op_start(h, &start);
+    e = h->pop(h->heap);
+    heap_op_count(h, HEAP_OP_POP, &start);
+    if (e != NULL) {
+        e->inserted = false;
+    }
+    return e;
+}
+
+struct element *
+heap_peek_max(struct heap *h)
+{
+    return h->peek_max(h->heap);
+}
+
+struct element *
+heap_pop_max(struct heap *h)
+{
+    struct heap_counts start;
+    struct element *e;
+
+    heap_op_start(h, &start);
+    e = h->pop_max(h->heap);
+    heap_op_count(h, HEAP_OP_POP, &start);
     if (e != NULL) {
         e->inserted = false;
     }
@@ -66,14 +149,26 @@ heap_pop(struct heap *h)
 void
 heap_update_key(struct heap *h, struct element *e, long long int v)
 {
+    struct heap_counts start;
+
+    heap_op_start(h, &start);
     e->priority = v;
     h->update(h->heap, e, v);
+    heap_op_count(h, HEAP_OP_UPDATE, &start);
+}
+
+size_t
+heap_peek_k(struct heap *h, size_t k, struct element *out[])
+{
+    return h->peek_k(h->heap, k, out);
 }
 
 void
 heap_validate(struct heap *h)
 {
-    n_cmp_enable(false);
+    struct heap_counts saved = heap_counts;
+
+    /* Validation is not part of the work of the heap. */
     h->validate(h->heap);
-    n_cmp_enable(true);
+    heap_counts = saved;
 }
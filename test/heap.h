@@ -7,15 +7,49 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 /*
  * This file describes a generic heap interface,
  * to be instanciated using any of the available implementations.
  */
 
+/* Work done by heaps, counted in the current thread. Heaps count it
+ * only when their file is compiled with HEAP_COUNTING defined,
+ * otherwise the instrumentation compiles to nothing. */
+struct heap_counts {
+    /* Number of operations, set by the generic interface. */
+    unsigned long long int ops;
+    unsigned long long int cmp;
+    /* Links between nodes, or moves of containers. */
+    unsigned long long int link;
+    /* Nodes reached by following a pointer. */
+    unsigned long long int deref;
+    unsigned long long int alloc;
+};
+
+extern _Thread_local struct heap_counts heap_counts;
+
+#ifdef HEAP_COUNTING
+#define HEAP_COUNT(EV) ((void) heap_counts.EV++)
+#define HEAP_OP_COUNTS ((struct heap_counts [HEAP_N_OPS]) { 0 })
+#else
+#define HEAP_COUNT(EV) ((void) 0)
+#define HEAP_OP_COUNTS NULL
+#endif
+
+/* Instrumentation hooks of each implementation. */
+#define PHEAP_INSTR(EV) HEAP_COUNT(EV)
+#define FHEAP_INSTR(EV) HEAP_COUNT(EV)
+#define BHEAP_INSTR(EV) HEAP_COUNT(EV)
+#define CQUEUE_INSTR(EV) HEAP_COUNT(EV)
+#define MMHEAP_INSTR(EV) HEAP_COUNT(EV)
+#define SHEAP_INSTR(EV) HEAP_COUNT(EV)
+
 /* Necessary for an intrusive type. */
 #include "pairing-heap.h"
 #include "fibonacci-heap.h"
+#include "calendar-queue.h"
 
 struct element {
     union {
@@ -23,28 +57,61 @@ struct element {
             union {
                 struct pheap_node hnode;
                 struct fheap_node fnode;
+                struct cqueue_node cnode;
+                /* Index within array-based heaps. */
+                size_t pos;
             };
             union {
                 long long int expiration;
                 long long int priority;
             };
             bool inserted;
+            /* Index of the element within its test. */
+            unsigned int id;
+            /* Rest of the key, see 'element_key_type'. */
+            union {
+                uint64_t hash;
+                char *name;
+            };
         };
         /* Take a whole cacheline per elements. */
         uint8_t pad[64];
     };
 };
 
-extern unsigned int n_cmp;
+_Static_assert(sizeof(struct element) == 64,
+               "elements must fit a cacheline");
+
+void heap_counts_reset(void);
+
+/* Elements are ordered by their priority, a 64-bit integer. Heaps can
+ * instead order them by a whole key, derived from the priority, once
+ * initialized by 'heap_init_keys':
+ *
+ *  - ELEMENT_KEY_32: its low 32 bits, compared with wrap-around
+ *    as timer wheels do; priorities must span less than 2^31,
+ *  - ELEMENT_KEY_64: the priority itself,
+ *  - ELEMENT_KEY_128: the priority, then the 'hash' of the element,
+ *  - ELEMENT_KEY_STRING: its 'name', which must be kept sorted
+ *    like the priority.
+ *
+ * Each comparison of whole keys additionally spins for
+ * 'element_cmp_cost' iterations. Both settings are global. */
+
+enum element_key_type {
+    ELEMENT_KEY_32,
+    ELEMENT_KEY_64,
+    ELEMENT_KEY_128,
+    ELEMENT_KEY_STRING,
+};
 
-void n_cmp_inc(void);
-void n_cmp_enable(bool enabled);
-void n_cmp_reset(void);
+extern enum element_key_type element_key_type;
+extern unsigned int element_cmp_cost;
 
 static inline int
 min_priority_cmp(long long int a, long long int b)
 {
-    n_cmp_inc();
+    HEAP_COUNT(cmp);
     /* Compare without risk of underflow. */
     return (a < b) ? -1 :
            (a > b) ? 1 :
@@ -70,6 +137,36 @@ max_element_cmp(const void *a, const void *b)
     return -min_element_cmp(a, b);
 }
 
+/* Compare the whole keys of elements 'a' and 'b', whose priorities
+ * 'pa' and 'pb' are at hand: elements are only read if needed. */
+static inline int
+min_element_key_cmp(long long int pa, long long int pb,
+                    const struct element *a, const struct element *b)
+{
+    int c;
+
+    for (unsigned int i = 0; i < element_cmp_cost; i++) {
+        __asm__ volatile ("");
+    }
+
+    switch (element_key_type) {
+    case ELEMENT_KEY_32:
+        HEAP_COUNT(cmp);
+        c = (int32_t) ((uint32_t) pa - (uint32_t) pb);
+        return (c > 0) - (c < 0);
+    case ELEMENT_KEY_128:
+        c = min_priority_cmp(pa, pb);
+        return c != 0 ? c : (a->hash > b->hash) - (a->hash < b->hash);
+    case ELEMENT_KEY_STRING:
+        HEAP_COUNT(cmp);
+        c = strcmp(a->name, b->name);
+        return (c > 0) - (c < 0);
+    case ELEMENT_KEY_64:
+    default:
+        return min_priority_cmp(pa, pb);
+    }
+}
+
 typedef void (*heap_init_fn)(void *heap, void *cmp);
 typedef bool (*heap_is_empty_fn)(void *heap);
 typedef void (*heap_insert_fn)(void *heap, struct element *e);
@@ -77,34 +174,98 @@ typedef struct element * (*heap_peek_fn)(void *heap);
 typedef struct element * (*heap_pop_fn)(void *heap);
 typedef void (*heap_update_fn)(void *heap, struct element *e, long long int v);
 typedef void (*heap_validate_fn)(void *heap);
+typedef size_t (*heap_peek_k_fn)(void *heap, size_t k, struct element *out[]);
+
+enum heap_op {
+    HEAP_OP_INSERT,
+    HEAP_OP_POP,
+    HEAP_OP_UPDATE,
+    HEAP_N_OPS,
+};
 
 struct heap {
     void *heap;
+    /* Size of the structure pointed by 'heap', for 'heap_create'. */
+    size_t heap_size;
     void *cmp;
     heap_init_fn init;
     heap_is_empty_fn is_empty;
     heap_insert_fn insert;
     heap_peek_fn peek;
     heap_pop_fn pop;
+    /* Access to the opposite end, only set for double-ended heaps. */
+    heap_peek_fn peek_max;
+    heap_pop_fn pop_max;
+    /* Key update, not set if unsupported. */
     heap_update_fn update;
     heap_validate_fn validate;
+    /* Non-destructive read of the first elements, not set if unsupported. */
+    heap_peek_k_fn peek_k;
     const char *desc;
+    /* Work done by each type of operation, NULL unless counting.
+     * Must be initialized with HEAP_OP_COUNTS. */
+    struct heap_counts *counts;
+    /* Bytes used within each element by the heap, besides
+     * the memory it allocates. */
+    size_t node_size;
+    /* Comparison of whole keys, used by 'heap_init_keys'.
+     * Not set if the heap only orders integer priorities. */
+    void *key_cmp;
 };
 
+/* Descriptors point to a single heap structure each, shared by their
+ * min and max variants. Create an instance of 'h' with its own heap
+ * and counts, to be used in another thread, released by 'heap_destroy'.
+ * The heap must be initialized and emptied as usual. */
+struct heap *heap_create(const struct heap *h);
+void heap_destroy(struct heap *h);
 void heap_init(struct heap *h);
+/* Initialize 'h' to order elements by their whole key.
+ * The heap must support it, setting 'key_cmp'. */
+void heap_init_keys(struct heap *h);
 bool heap_is_empty(struct heap *h);
 void heap_insert(struct heap *h, struct element *e);
 struct element *heap_peek(struct heap *h);
 struct element *heap_pop(struct heap *h);
+struct element *heap_peek_max(struct heap *h);
+struct element *heap_pop_max(struct heap *h);
 void heap_update_key(struct heap *h, struct element *e, long long int v);
 void heap_validate(struct heap *h);
+size_t heap_peek_k(struct heap *h, size_t k, struct element *out[]);
+/* Clear the counts of all operations of 'h'. */
+void heap_op_counts_reset(struct heap *h);
 
 extern struct heap min_pairing_heap;
 extern struct heap min_binary_heap;
+extern struct heap min_paged_binary_heap;
 extern struct heap min_fibonacci_heap;
+extern struct heap min_calendar_queue;
+extern struct heap min_minmax_heap;
+extern struct heap min_sequence_heap;
 
 extern struct heap max_pairing_heap;
 extern struct heap max_binary_heap;
+extern struct heap max_paged_binary_heap;
 extern struct heap max_fibonacci_heap;
+extern struct heap max_calendar_queue;
+extern struct heap max_minmax_heap;
+extern struct heap max_sequence_heap;
+
+/* The same heaps, compiled with HEAP_COUNTING. */
+extern struct heap min_pairing_heap_counted;
+extern struct heap min_binary_heap_counted;
+extern struct heap min_paged_binary_heap_counted;
+extern struct heap min_fibonacci_heap_counted;
+extern struct heap min_calendar_queue_counted;
+extern struct heap min_minmax_heap_counted;
+extern struct heap min_sequence_heap_counted;
+
+extern struct heap max_pairing_heap_counted;
+extern struct heap max_binary_heap_counted;
+extern struct heap max_paged_binary_heap_counted;
+extern struct heap max_fibonacci_heap_counted;
+extern struct heap max_calendar_queue_counted;
+extern struct heap max_minmax_heap_counted;
+extern struct heap max_sequence_heap_counted;
 
 #endif /* HEAP_H */
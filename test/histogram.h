@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H 1
+
+#include <stdint.h>
+#include <string.h>
+
+/* Log-linear histogram.
+ *
+ * Records non-negative integer values, such as latencies in nanoseconds,
+ * in constant time and memory, in the manner of HdrHistogram.
+ *
+ * Values below 2^HISTOGRAM_SUB_BITS have a bucket each. Above, each power
+ * of two is split in 2^HISTOGRAM_SUB_BITS buckets of equal width, so that
+ * any value is known within 1 / 2^HISTOGRAM_SUB_BITS of itself: about 3%
+ * with the default of 5 bits. The whole 64 bits range is covered.
+ *
+ * Percentiles are read back as the middle of the bucket holding them,
+ * except the maximum which is kept exactly.
+ */
+
+#ifndef HISTOGRAM_SUB_BITS
+#define HISTOGRAM_SUB_BITS 5
+#endif
+
+#define HISTOGRAM_SUB (1ULL << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_N_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB)
+
+struct histogram {
+    unsigned long long int count;
+    unsigned long long int max;
+    unsigned long long int buckets[HISTOGRAM_N_BUCKETS];
+};
+
+static inline void
+histogram_init(struct histogram *h)
+{
+    memset(h, 0, sizeof *h);
+}
+
+static inline size_t
+histogram_index(unsigned long long int v)
+{
+    unsigned int shift;
+
+    if (v < HISTOGRAM_SUB) {
+        return v;
+    }
+
+    /* Position of the highest bit set, above the sub-bucket bits. */
+    shift = 63 - __builtin_clzll(v) - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB + ((v >> shift) - HISTOGRAM_SUB);
+}
+
+/* Lowest value of bucket 'i'. */
+static inline unsigned long long int
+histogram_bucket_low(size_t i)
+{
+    unsigned int shift;
+
+    if (i < HISTOGRAM_SUB) {
+        return i;
+    }
+
+    shift = i / HISTOGRAM_SUB - 1;
+    return (HISTOGRAM_SUB + i % HISTOGRAM_SUB) << shift;
+}
+
+static inline unsigned long long int
+histogram_bucket_mid(size_t i)
+{
+    unsigned long long int low = histogram_bucket_low(i);
+
+    if (i < HISTOGRAM_SUB) {
+        return low;
+    }
+    return low + ((1ULL << (i / HISTOGRAM_SUB - 1)) >> 1);
+}
+
+static inline void
+histogram_add(struct histogram *h, unsigned long long int v)
+{
+    h->buckets[histogram_index(v)]++;
+    h->count++;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+/* Returns the value below which 'p' percents of the values fall,
+ * 0 if the histogram is empty. */
+static inline unsigned long long int
+histogram_percentile(struct histogram *h, double p)
+{
+    unsigned long long int rank;
+    unsigned long long int seen = 0;
+    unsigned long long int v;
+
+    if (h->count == 0) {
+        return 0;
+    }
+
+    rank = (p / 100.) * h->count + .5;
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank >= h->count) {
+        return h->max;
+    }
+
+    for (size_t i = 0; i < HISTOGRAM_N_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            v = histogram_bucket_mid(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+#endif /* _HISTOGRAM_H */
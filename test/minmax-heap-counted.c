@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* The same heap, built with its instrumentation enabled. */
+
+#define HEAP_COUNTING
+
+#define min_minmax_heap min_minmax_heap_counted
+#define max_minmax_heap max_minmax_heap_counted
+
+#include "minmax-heap.c"
@@ -0,0 +1,165 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <stdio.h>
+
+#include "heap.h"
+
+#include "minmax-heap.h"
+#include "util.h"
+
+/* Both variants use the same order. The max variant
+ * only reverses the ends used by 'pop' and 'pop_max'. */
+
+static int
+min_node_cmp(struct mmheap_node *a, struct mmheap_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+static int
+min_node_key_cmp(struct mmheap_node *a, struct mmheap_node *b)
+{
+    return min_element_key_cmp(a->priority.lli, b->priority.lli,
+                               a->data, b->data);
+}
+
+static void
+minmax_heap_init(void *aux, void *cmp)
+{
+    return mmheap_init(aux, cmp);
+}
+
+static bool
+minmax_heap_is_empty(void *aux)
+{
+    return mmheap_is_empty(aux);
+}
+
+static void
+minmax_heap_insert(void *aux, struct element *e)
+{
+    struct mmheap_node n = {
+        .data = e,
+        .priority.lli = e->priority,
+        .index = &e->pos,
+    };
+
+    mmheap_insert(aux, n);
+}
+
+static struct element *
+minmax_heap_peek_min(void *aux)
+{
+    return mmheap_peek_min(aux);
+}
+
+static struct element *
+minmax_heap_peek_max(void *aux)
+{
+    return mmheap_peek_max(aux);
+}
+
+static struct element *
+minmax_heap_pop_min(void *aux)
+{
+    return mmheap_pop_min(aux);
+}
+
+static struct element *
+minmax_heap_pop_max(void *aux)
+{
+    return mmheap_pop_max(aux);
+}
+
+static void
+minmax_heap_update(void *heap, struct element *e, long long int v)
+{
+    struct mmheap_node k = {
+        .data = e,
+        .priority.lli = v,
+        .index = &e->pos,
+    };
+
+    mmheap_update_key(heap, e->pos, k);
+}
+
+static void
+minmax_heap_validate(void *_h)
+{
+    struct mmheap *h = _h;
+    struct mmheap_node *n = h->entries;
+    size_t i, j, last;
+
+    for (i = 0; i < h->n; i++) {
+        bool max = mmheap_is_max_level(i);
+
+        if (*n[i].index != i) {
+            printf("size=%zu, node %zu has index %zu\n",
+                   h->n, i, *n[i].index);
+            abort();
+        }
+
+        /* Checking children and grandchildren is sufficient,
+         * by transitivity on each kind of level. */
+        last = MIN(MMHEAP_GRANDCHILD(i) + 4, h->n);
+        for (j = MMHEAP_CHILD(i); j < last; j++) {
+            if (j == MMHEAP_CHILD(i) + 2) {
+                j = MMHEAP_GRANDCHILD(i);
+                if (j >= last) {
+                    break;
+                }
+            }
+            if (mmheap_before(h, j, i, max)) {
+                struct element *e[2] = { n[i].data, n[j].data };
+
+                printf("size=%zu, failing on %s node %zu (%lld) "
+                       "with descendant %zu (%lld)\n",
+                       h->n, max ? "max" : "min",
+                       i, e[0]->priority, j, e[1]->priority);
+                abort();
+            }
+        }
+    }
+}
+
+static struct mmheap heap;
+
+struct heap min_minmax_heap = {
+    .heap = &heap,
+    .heap_size = sizeof heap,
+    .cmp = min_node_cmp,
+    .init = minmax_heap_init,
+    .is_empty = minmax_heap_is_empty,
+    .insert = minmax_heap_insert,
+    .peek = minmax_heap_peek_min,
+    .pop = minmax_heap_pop_min,
+    .peek_max = minmax_heap_peek_max,
+    .pop_max = minmax_heap_pop_max,
+    .update = minmax_heap_update,
+    .validate = minmax_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(size_t),
+    .key_cmp = min_node_key_cmp,
+    .desc = "min-minmax-heap",
+};
+
+struct heap max_minmax_heap = {
+    .heap = &heap,
+    .heap_size = sizeof heap,
+    .cmp = min_node_cmp,
+    .init = minmax_heap_init,
+    .is_empty = minmax_heap_is_empty,
+    .insert = minmax_heap_insert,
+    .peek = minmax_heap_peek_max,
+    .pop = minmax_heap_pop_max,
+    .peek_max = minmax_heap_peek_min,
+    .pop_max = minmax_heap_pop_min,
+    .update = minmax_heap_update,
+    .validate = minmax_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(size_t),
+    .key_cmp = min_node_key_cmp,
+    .desc = "max-minmax-heap",
+};
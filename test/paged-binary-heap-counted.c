@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* The same heap, built with its instrumentation enabled. */
+
+#define HEAP_COUNTING
+
+#define min_paged_binary_heap min_paged_binary_heap_counted
+#define max_paged_binary_heap max_paged_binary_heap_counted
+
+#include "paged-binary-heap.c"
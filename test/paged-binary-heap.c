@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+/* The binary heap, using a B-heap layout of its array.
+ * With 24 bytes containers, a page of 2^7 takes 3kB. */
+
+#define BHEAP_PAGE_SHIFT 7
+
+#define min_binary_heap min_paged_binary_heap
+#define max_binary_heap max_paged_binary_heap
+#define BINARY_HEAP_DESC "paged-binary-heap"
+
+#include "binary-heap.c"
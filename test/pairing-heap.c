@@ -27,6 +27,24 @@ max_node_cmp(struct pheap_node *a, struct pheap_node *b)
     return -min_node_cmp(a, b);
 }
 
+ALLOW_UNDEFINED_BEHAVIOR
+static int
+min_node_key_cmp(struct pheap_node *a, struct pheap_node *b)
+{
+    struct element *e[2] = {
+        container_of(a, struct element, hnode),
+        container_of(b, struct element, hnode),
+    };
+
+    return min_element_key_cmp(e[0]->priority, e[1]->priority, e[0], e[1]);
+}
+
+static int
+max_node_key_cmp(struct pheap_node *a, struct pheap_node *b)
+{
+    return -min_node_key_cmp(a, b);
+}
+
 static void
 pairing_heap_init(void *heap, void *cmp)
 {
@@ -73,6 +91,21 @@ pairing_heap_pop(void *heap)
     }
 }
 
+ALLOW_UNDEFINED_BEHAVIOR
+static size_t
+pairing_heap_peek_k(void *heap, size_t k, struct element *out[])
+{
+    struct pheap_node **nodes = xmalloc(k * sizeof nodes[0]);
+    size_t i, n;
+
+    n = pheap_peek_k(heap, k, nodes);
+    for (i = 0; i < n; i++) {
+        out[i] = container_of(nodes[i], struct element, hnode);
+    }
+    free(nodes);
+    return n;
+}
+
 static void
 pairing_heap_update(void *heap, struct element *e, long long int v)
 {
@@ -112,6 +145,7 @@ static struct pheap heap;
 
 struct heap min_pairing_heap = {
     .heap = &heap,
+    .heap_size = sizeof heap,
     .cmp = min_node_cmp,
     .init = pairing_heap_init,
     .is_empty = pairing_heap_is_empty,
@@ -120,11 +154,16 @@ struct heap min_pairing_heap = {
     .pop = pairing_heap_pop,
     .update = pairing_heap_update,
     .validate = pairing_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(struct pheap_node),
+    .key_cmp = min_node_key_cmp,
+    .peek_k = pairing_heap_peek_k,
     .desc = "min-pairing-heap",
 };
 
 struct heap max_pairing_heap = {
     .heap = &heap,
+    .heap_size = sizeof heap,
     .cmp = max_node_cmp,
     .init = pairing_heap_init,
     .is_empty = pairing_heap_is_empty,
@@ -133,5 +172,9 @@ struct heap max_pairing_heap = {
     .pop = pairing_heap_pop,
     .update = pairing_heap_update,
     .validate = pairing_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = sizeof(struct pheap_node),
+    .key_cmp = max_node_key_cmp,
+    .peek_k = pairing_heap_peek_k,
     .desc = "max-pairing-heap",
 };
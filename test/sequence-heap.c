@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <stdio.h>
+
+#include "heap.h"
+
+#include "sequence-heap.h"
+#include "util.h"
+
+static int
+min_node_cmp(struct sheap_node *a, struct sheap_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+static int
+max_node_cmp(struct sheap_node *a, struct sheap_node *b)
+{
+    return -min_node_cmp(a, b);
+}
+
+static int
+min_node_key_cmp(struct sheap_node *a, struct sheap_node *b)
+{
+    return min_element_key_cmp(a->priority.lli, b->priority.lli,
+                               a->data, b->data);
+}
+
+static int
+max_node_key_cmp(struct sheap_node *a, struct sheap_node *b)
+{
+    return -min_node_key_cmp(a, b);
+}
+
+static void
+sequence_heap_init(void *aux, void *cmp)
+{
+    return sheap_init(aux, cmp);
+}
+
+static bool
+sequence_heap_is_empty(void *aux)
+{
+    return sheap_is_empty(aux);
+}
+
+static void
+sequence_heap_insert(void *aux, struct element *e)
+{
+    struct sheap_node n = {
+        .data = e,
+        .priority.lli = e->priority,
+    };
+
+    sheap_insert(aux, n);
+}
+
+static struct element *
+sequence_heap_peek(void *aux)
+{
+    return sheap_peek(aux);
+}
+
+static struct element *
+sequence_heap_pop(void *aux)
+{
+    return sheap_pop(aux);
+}
+
+static void
+check_order(struct sheap *h, struct sheap_node *a, struct sheap_node *b,
+            const char *desc)
+{
+    if (h->cmp(a, b) > 0) {
+        struct element *e[2] = { a->data, b->data };
+
+        printf("n=%zu, %s: %lld before %lld\n",
+               h->n, desc, e[0]->priority, e[1]->priority);
+        abort();
+    }
+}
+
+static void
+sequence_heap_validate(void *_h)
+{
+    struct sheap *h = _h;
+    struct sheap_node *last_del = NULL;
+    size_t count;
+    size_t i, j, k;
+
+    count = h->n_ins + h->n_del - h->del_head;
+
+    for (i = 1; i < h->n_ins; i++) {
+        check_order(h, &h->ins[(i - 1) / 2], &h->ins[i], "insertion heap");
+    }
+
+    for (i = h->del_head; i < h->n_del; i++) {
+        if (last_del != NULL) {
+            check_order(h, last_del, &h->del[i], "deletion buffer");
+        }
+        last_del = &h->del[i];
+    }
+
+    for (i = 0; i < SHEAP_N_GROUPS; i++) {
+        struct sheap_group *g = &h->groups[i];
+
+        for (j = 0; j < g->n_runs; j++) {
+            struct sheap_run *r = &g->runs[j];
+
+            if (r->head >= r->n) {
+                printf("group %zu: run %zu is empty\n", i, j);
+                abort();
+            }
+            if (last_del != NULL) {
+                check_order(h, last_del, &r->entries[r->head],
+                            "deletion buffer and run");
+            }
+            for (k = r->head + 1; k < r->n; k++) {
+                check_order(h, &r->entries[k - 1], &r->entries[k], "run");
+            }
+            count += r->n - r->head;
+        }
+    }
+
+    if (count != h->n) {
+        printf("n=%zu, but %zu elements found\n", h->n, count);
+        abort();
+    }
+}
+
+static struct sheap heap;
+
+struct heap min_sequence_heap = {
+    .heap = &heap,
+    .heap_size = sizeof heap,
+    .cmp = min_node_cmp,
+    .init = sequence_heap_init,
+    .is_empty = sequence_heap_is_empty,
+    .insert = sequence_heap_insert,
+    .peek = sequence_heap_peek,
+    .pop = sequence_heap_pop,
+    .update = NULL,
+    .validate = sequence_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = 0,
+    .key_cmp = min_node_key_cmp,
+    .desc = "min-sequence-heap",
+};
+
+struct heap max_sequence_heap = {
+    .heap = &heap,
+    .heap_size = sizeof heap,
+    .cmp = max_node_cmp,
+    .init = sequence_heap_init,
+    .is_empty = sequence_heap_is_empty,
+    .insert = sequence_heap_insert,
+    .peek = sequence_heap_peek,
+    .pop = sequence_heap_pop,
+    .update = NULL,
+    .validate = sequence_heap_validate,
+    .counts = HEAP_OP_COUNTS,
+    .node_size = 0,
+    .key_cmp = max_node_key_cmp,
+    .desc = "max-sequence-heap",
+};
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#include <stdlib.h>
+
+#include "histogram.h"
+#include "timer.h"
+
+#ifdef TIMER_HAS_TSC
+#include <cpuid.h>
+#endif
+
+struct timer timer = {
+    .tsc = false,
+    .freq = 1.,
+    .overhead = 0,
+    .source = "clock_gettime",
+};
+
+#ifdef TIMER_HAS_TSC
+static bool
+tsc_is_invariant(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) ||
+        eax < 0x80000007) {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+}
+
+/* Count the ticks of the TSC during 20ms of the monotonic clock. */
+static double
+tsc_calibrate(void)
+{
+    long long int t0, t1;
+    uint64_t c0, c1;
+
+    t0 = time_nsec();
+    c0 = timer_start();
+    do {
+        t1 = time_nsec();
+    } while (t1 - t0 < 20 * 1000 * 1000);
+    c1 = timer_stop();
+
+    return (double) (c1 - c0) / (t1 - t0);
+}
+#endif
+
+static uint64_t
+timer_overhead(void)
+{
+    struct histogram *h = xmalloc(sizeof *h);
+    uint64_t start, overhead;
+
+    histogram_init(h);
+    for (size_t i = 0; i < 10000; i++) {
+        start = timer_start();
+        histogram_add(h, timer_stop() - start);
+    }
+    overhead = histogram_percentile(h, 50);
+    free(h);
+
+    return overhead;
+}
+
+void
+timer_init(bool use_tsc)
+{
+#ifdef TIMER_HAS_TSC
+    if (use_tsc && tsc_is_invariant()) {
+        timer.tsc = true;
+        timer.freq = tsc_calibrate();
+        timer.source = "tsc";
+    }
+#else
+    (void) use_tsc;
+#endif
+    timer.overhead = timer_overhead();
+}
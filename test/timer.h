@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIMER_HAS_TSC 1
+#endif
+
+/* Low-overhead timer for short measures.
+ *
+ * On x86, the time stamp counter is read if it is invariant, i.e.
+ * ticking at a constant rate whatever the power state of the core.
+ * Its frequency is calibrated against the monotonic clock on init.
+ * Otherwise, or when requested, the monotonic clock is read instead,
+ * a tick then being a nanosecond.
+ *
+ * Reads are fenced so that the measured code cannot be moved out
+ * of the interval by the processor: 'timer_start' waits for previous
+ * instructions before reading the counter, and later instructions
+ * wait for the read. 'timer_stop' waits for the measured code, and
+ * following instructions wait for it.
+ *
+ * The cost of a start and stop pair, measured on init, is kept in
+ * 'timer.overhead' to be subtracted from measures.
+ */
+
+struct timer {
+    bool tsc;
+    /* Ticks per nanosecond. */
+    double freq;
+    /* Median ticks between a start and a stop. */
+    uint64_t overhead;
+    const char *source;
+};
+
+extern struct timer timer;
+
+/* Select the timer source, the monotonic clock being forced if
+ * 'use_tsc' is false, then calibrate it. */
+void timer_init(bool use_tsc);
+
+static inline uint64_t
+timer_start(void)
+{
+#ifdef TIMER_HAS_TSC
+    if (timer.tsc) {
+        uint64_t t;
+
+        _mm_lfence();
+        t = __rdtsc();
+        _mm_lfence();
+        return t;
+    }
+#endif
+    return time_nsec();
+}
+
+static inline uint64_t
+timer_stop(void)
+{
+#ifdef TIMER_HAS_TSC
+    if (timer.tsc) {
+        unsigned int aux;
+        uint64_t t;
+
+        t = __rdtscp(&aux);
+        _mm_lfence();
+        return t;
+    }
+#endif
+    return time_nsec();
+}
+
+/* Nanoseconds measured between 'start' and 'stop', without the
+ * timer overhead. */
+static inline uint64_t
+timer_ns(uint64_t start, uint64_t stop)
+{
+    uint64_t ticks = stop - start;
+
+    ticks = ticks > timer.overhead ? ticks - timer.overhead : 0;
+    return ticks / timer.freq;
+}
+
+#endif /* TIMER_H */
@@ -8,14 +8,32 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
 
+/* Check the inline counters against the shape statistics. */
+#define BHEAP_COUNTERS
+#define FHEAP_COUNTERS
+#define PHEAP_COUNTERS
+
 #include "mov-avg.h"
 #include "util.h"
 #include "heap.h"
 
 #include "unit.h"
 
+#include "binary-heap.h"
+#include "external-heap.h"
+#include "tournament-tree.h"
+
+/* Use a small geometry, to go through all levels
+ * of the sequence heap with few elements. */
+#define SHEAP_INS_SIZE 4
+#define SHEAP_DEL_SIZE 4
+#define SHEAP_K 3
+#define SHEAP_N_GROUPS 3
+#include "sequence-heap.h"
+
 static bool verbose;
 
 static struct unit_params params = {
@@ -110,13 +128,11 @@ elements_init(struct element e[], size_t n, enum init_mode mode)
     for (i = 0; i < n; i++) {
         e[i].priority = random_u32();
     }
-    n_cmp_enable(false);
     if (mode == INCREASING) {
         qsort(e, n, sizeof e[0], min_element_cmp);
     } else if (mode == DECREASING) {
         qsort(e, n, sizeof e[0], max_element_cmp);
     }
-    n_cmp_enable(true);
 }
 
 static char *mode2txt[] = {
@@ -142,15 +158,16 @@ int (*cmps[])(long long int, long long int) = {
 };
 
 static void
-print_n_cmp(const char *heap_desc,
-            const char *step_desc,
-            enum init_mode mode)
+print_counts(const char *heap_desc,
+             const char *step_desc,
+             enum init_mode mode)
 {
     if (verbose) {
-        printf("%s %s[%s]: n-cmp: %.0e\n",
+        printf("%s %s[%s]: n-cmp: %.0e n-link: %.0e n-deref: %.0e\n",
                 heap_desc, step_desc, mode2txt[mode],
-                (double) n_cmp);
-        n_cmp_reset();
+                (double) heap_counts.cmp, (double) heap_counts.link,
+                (double) heap_counts.deref);
+        heap_counts_reset();
     }
 }
 
@@ -172,13 +189,13 @@ test_basic_insertion(struct unit_test *u)
     elements = xcalloc(n, sizeof elements[0]);
     prios = xcalloc(n, sizeof prios[0]);
 
-    n_cmp_reset();
+    heap_counts_reset();
     elements_init(elements, n, mode);
     for (i = 0; i < n; i++) {
         heap_insert(h, &elements[i]);
         heap_validate(h);
     }
-    print_n_cmp(h->desc, "insertions", mode);
+    print_counts(h->desc, "insertions", mode);
 
     i = 0;
     while ((top = heap_pop(h)) != NULL) {
@@ -189,7 +206,7 @@ test_basic_insertion(struct unit_test *u)
     assert("Unexpected number of removal." && i == n);
     assert("Heap unexpectedly non-empty." && heap_is_empty(h));
 
-    print_n_cmp(h->desc, "removals", mode);
+    print_counts(h->desc, "removals", mode);
 
     for (i = 0; i < n - 1; i++) {
         long long int a = prios[i], b = prios[i + 1];
@@ -247,33 +264,33 @@ test_modify_key_(struct unit_test *u)
     elements = xcalloc(n, sizeof elements[0]);
     prios = xcalloc(n, sizeof prios[0]);
 
-    n_cmp_reset();
+    heap_counts_reset();
     elements_init(elements, n, mode);
     for (i = 0; i < n; i++) {
         heap_insert(h, &elements[i]);
         heap_validate(h);
     }
-    print_n_cmp(h->desc, "insertions", mode);
+    print_counts(h->desc, "insertions", mode);
 
     /* Increase one element to max possible value. */
     heap_update_key(h, &elements[0], LLONG_MAX);
     heap_validate(h);
-    print_n_cmp(h->desc, "increase-0", mode);
+    print_counts(h->desc, "increase-0", mode);
 
     /* Decrease one element to min possible value. */
     heap_update_key(h, &elements[n - 1], 0);
     heap_validate(h);
-    print_n_cmp(h->desc, "decrease-N", mode);
+    print_counts(h->desc, "decrease-N", mode);
 
     /* Decrease one element to min possible value. */
     heap_update_key(h, &elements[n / 2], 0);
     heap_validate(h);
-    print_n_cmp(h->desc, "decrease-half", mode);
+    print_counts(h->desc, "decrease-half", mode);
 
     /* Increase one element to max possible value. */
     heap_update_key(h, &elements[n / 2], LLONG_MAX);
     heap_validate(h);
-    print_n_cmp(h->desc, "increase-half", mode);
+    print_counts(h->desc, "increase-half", mode);
 
     i = 0;
     while ((top = heap_pop(h)) != NULL) {
@@ -284,7 +301,7 @@ test_modify_key_(struct unit_test *u)
     assert("Unexpected number of removal." && i == n);
     assert("Heap unexpectedly non-empty." && heap_is_empty(h));
 
-    print_n_cmp(h->desc, "removals", mode);
+    print_counts(h->desc, "removals", mode);
 
     for (i = 0; i < n - 1; i++) {
         long long int a = prios[i], b = prios[i + 1];
@@ -324,6 +341,834 @@ test_modify_key(struct heap *h)
     }
 }
 
+static int
+lli_cmp(const void *_a, const void *_b)
+{
+    const long long int *a = _a, *b = _b;
+
+    return min_priority_cmp(*a, *b);
+}
+
+static void
+test_double_ended_(struct unit_test *u)
+{
+    struct unit_params *p = &u->params;
+    enum init_mode mode = p->mode;
+    unsigned int n = p->n_elems;
+    struct element *elements;
+    struct heap *h = u->h;
+    long long int *prios;
+    bool descending;
+    size_t lo, hi;
+    size_t i;
+
+    heap_init(h);
+
+    elements = xcalloc(n, sizeof elements[0]);
+    prios = xcalloc(n, sizeof prios[0]);
+
+    heap_counts_reset();
+    elements_init(elements, n, mode);
+    for (i = 0; i < n; i++) {
+        heap_insert(h, &elements[i]);
+        heap_validate(h);
+    }
+    print_counts(h->desc, "insertions", mode);
+
+    heap_update_key(h, &elements[0], LLONG_MAX);
+    heap_validate(h);
+    heap_update_key(h, &elements[n - 1], 0);
+    heap_validate(h);
+    print_counts(h->desc, "updates", mode);
+
+    /* The reference order is the sorted priorities. */
+    for (i = 0; i < n; i++) {
+        prios[i] = elements[i].priority;
+    }
+    qsort(prios, n, sizeof prios[0], lli_cmp);
+
+    descending = (heap_peek(h)->priority != prios[0]);
+    assert("Unexpected max element." &&
+           heap_peek_max(h)->priority == prios[descending ? 0 : n - 1]);
+
+    lo = 0;
+    hi = n;
+    while (!heap_is_empty(h)) {
+        bool from_max = random_u32_range(2);
+        struct element *e;
+        long long int v;
+
+        e = from_max ? heap_pop_max(h) : heap_pop(h);
+        v = (from_max != descending) ? prios[--hi] : prios[lo++];
+        assert("Unexpected element removed." && e->priority == v);
+        heap_validate(h);
+    }
+    assert("Unexpected number of removal." && lo == hi);
+
+    print_counts(h->desc, "removals", mode);
+
+    free(elements);
+    free(prios);
+}
+
+static void
+test_double_ended(struct heap *h)
+{
+    struct unit_test u = UNIT_INITIALIZER;
+    enum init_mode mode;
+
+    u.params = (struct unit_params) params;
+    u.h = h;
+
+    if (verbose) {
+        printf("Running double-ended tests on %s with %.0e elements:\n",
+               h->desc, (double) u.params.n_elems);
+    }
+
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        u.params.mode = mode;
+        test_double_ended_(&u);
+    }
+}
+
+/* Read the first elements with 'peek_k', then check
+ * that the heap gives them back in the same order. */
+static void
+test_peek_k_(struct unit_test *u)
+{
+    struct unit_params *p = &u->params;
+    unsigned int n = p->n_elems;
+    size_t ks[] = { 1, 7, n / 3 + 1, n + 3 };
+    struct element *elements;
+    struct heap *h = u->h;
+    struct element **out;
+    struct element *top;
+    size_t remaining = n;
+    size_t round = 0;
+    size_t i, k, m;
+
+    heap_init(h);
+
+    elements = xcalloc(n, sizeof elements[0]);
+    out = xcalloc(n + 3, sizeof out[0]);
+
+    elements_init(elements, n, p->mode);
+    for (i = 0; i < n; i++) {
+        heap_insert(h, &elements[i]);
+    }
+    if (h->update != NULL) {
+        for (i = 0; i < n; i += 5) {
+            heap_update_key(h, &elements[i], elements[i].priority / 2);
+        }
+    }
+
+    while (remaining > 0) {
+        k = ks[round++ % ARRAY_SIZE(ks)];
+        m = heap_peek_k(h, k, out);
+        heap_validate(h);
+        assert("Unexpected number of elements peeked." &&
+               m == MIN(k, remaining));
+
+        /* Only remove half of them, to peek at a modified heap. */
+        for (i = 0; i < m / 2 + 1; i++) {
+            top = heap_pop(h);
+            assert("Inconsistent peek order." &&
+                   top != NULL && top->priority == out[i]->priority);
+            remaining--;
+        }
+    }
+    assert("Unexpected element left." && heap_pop(h) == NULL);
+    assert("Heap not emptied." && heap_is_empty(h));
+
+    free(out);
+    free(elements);
+}
+
+static void
+test_peek_k(struct heap *h)
+{
+    struct unit_test u = UNIT_INITIALIZER;
+    enum init_mode mode;
+
+    u.params = (struct unit_params) params;
+    u.h = h;
+
+    if (verbose) {
+        printf("Running peek_k tests on %s with %.0e elements:\n",
+               h->desc, (double) u.params.n_elems);
+    }
+
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        u.params.mode = mode;
+        test_peek_k_(&u);
+    }
+}
+
+static int
+bheap_node_cmp(struct bheap_node *a, struct bheap_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+static void
+binary_heap_fill(struct bheap *h, struct element e[], size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        struct bheap_node node = {
+            .data = &e[i],
+            .priority.lli = e[i].priority,
+        };
+
+        bheap_insert(h, node);
+    }
+    /* Burn some entries by updating their key. */
+    for (i = 0; i < n; i += 3) {
+        struct bheap_node node = {
+            .data = &e[i],
+            .priority.lli = e[i].priority / 2,
+        };
+
+        e[i].priority = node.priority.lli;
+        bheap_update_key(h, node);
+    }
+}
+
+static void
+test_binary_heap_merge_(size_t n1, size_t n2, enum init_mode mode)
+{
+    struct bheap h1 = BHEAP_INITIALIZER(bheap_node_cmp);
+    struct bheap h2 = BHEAP_INITIALIZER(bheap_node_cmp);
+    struct element *elements;
+    long long int last = LLONG_MIN;
+    struct element *top;
+    size_t count = 0;
+
+    elements = xcalloc(n1 + n2, sizeof elements[0]);
+    elements_init(elements, n1 + n2, mode);
+
+    binary_heap_fill(&h1, elements, n1);
+    binary_heap_fill(&h2, &elements[n1], n2);
+
+    bheap_merge(&h1, &h2);
+    assert("Merged heap not emptied." && bheap_is_empty(&h2));
+    assert("Merged heap not released." && h2.entries == NULL);
+
+    while ((top = bheap_pop(&h1)) != NULL) {
+        assert("Inconsistent sorting of keys." && top->priority >= last);
+        assert("Element removed twice." && !top->inserted);
+        top->inserted = true;
+        last = top->priority;
+        count++;
+    }
+    assert("Unexpected number of removal." && count == n1 + n2);
+
+    free(elements);
+}
+
+static void
+test_binary_heap_merge(void)
+{
+    unsigned int n = params.n_elems;
+    enum init_mode mode;
+
+    if (verbose) {
+        printf("Running merge tests on binary heaps with %.0e elements:\n",
+               (double) n);
+    }
+
+    /* Cover both strategies, with either heap being the larger. */
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        test_binary_heap_merge_(n, 0, mode);
+        test_binary_heap_merge_(0, n, mode);
+        test_binary_heap_merge_(n, n, mode);
+        test_binary_heap_merge_(n, n / 50 + 1, mode);
+        test_binary_heap_merge_(n / 50 + 1, n, mode);
+    }
+}
+
+/* Offer 'n' elements to a heap bounded to 'k', the first half one by one
+ * and the rest by batch, and check that it kept the 'k' largest. */
+static void
+test_binary_heap_top_k_(size_t n, size_t k, enum init_mode mode)
+{
+    struct bheap h = BHEAP_BOUNDED_INITIALIZER(bheap_node_cmp, k);
+    struct bheap_node batch[64];
+    struct element *elements;
+    long long int *prios;
+    struct element *top;
+    size_t expected;
+    size_t count = 0;
+    size_t i, j;
+
+    elements = xcalloc(n, sizeof elements[0]);
+    prios = xcalloc(n, sizeof prios[0]);
+    elements_init(elements, n, mode);
+
+    for (i = 0; i < n; i++) {
+        prios[i] = elements[i].priority;
+    }
+    qsort(prios, n, sizeof prios[0], lli_cmp);
+
+    for (i = 0; i < n / 2; i++) {
+        struct bheap_node node = {
+            .data = &elements[i],
+            .priority.lli = elements[i].priority,
+        };
+
+        bheap_offer(&h, node);
+        assert("Bound exceeded." && h.n <= k);
+    }
+    while (i < n) {
+        for (j = 0; j < ARRAY_SIZE(batch) && i < n; j++, i++) {
+            batch[j] = (struct bheap_node) {
+                .data = &elements[i],
+                .priority.lli = elements[i].priority,
+            };
+        }
+        bheap_offer_batch(&h, batch, j);
+        assert("Bound exceeded." && h.n <= k);
+    }
+
+    expected = MIN(n, k);
+    while ((top = bheap_pop(&h)) != NULL) {
+        assert("Too many elements kept." && count < expected);
+        assert("Element removed twice." && !top->inserted);
+        assert("Unexpected element kept." &&
+               top->priority == prios[n - expected + count]);
+        top->inserted = true;
+        count++;
+    }
+    assert("Unexpected number of removal." && count == expected);
+
+    free(prios);
+    free(elements);
+}
+
+static void
+test_binary_heap_top_k(void)
+{
+    unsigned int n = params.n_elems;
+    enum init_mode mode;
+
+    if (verbose) {
+        printf("Running top-k tests on binary heaps with %.0e elements:\n",
+               (double) n);
+    }
+
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        test_binary_heap_top_k_(n, 1, mode);
+        test_binary_heap_top_k_(n, n / 50 + 1, mode);
+        test_binary_heap_top_k_(n, n / 2 + 1, mode);
+        test_binary_heap_top_k_(n, n, mode);
+        test_binary_heap_top_k_(n, 2 * n + 1, mode);
+    }
+}
+
+static int
+sheap_node_cmp(struct sheap_node *a, struct sheap_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+/* Pop the top of 'h' and check that it precedes
+ * all elements still marked as inserted. */
+static void
+sequence_heap_check_pop(struct sheap *h, struct element e[], size_t n)
+{
+    struct element *top = sheap_pop(h);
+    size_t i;
+
+    assert("Unexpected element removed." && top != NULL && top->inserted);
+    for (i = 0; i < n; i++) {
+        assert("Inconsistent sorting of keys." &&
+               (!e[i].inserted || e[i].priority >= top->priority));
+    }
+    top->inserted = false;
+}
+
+static void
+test_sequence_heap_(struct unit_test *u)
+{
+    struct unit_params *p = &u->params;
+    unsigned int n = p->n_elems;
+    struct element *elements;
+    struct sheap h;
+    size_t i;
+
+    sheap_init(&h, sheap_node_cmp);
+
+    elements = xcalloc(n, sizeof elements[0]);
+
+    elements_init(elements, n, p->mode);
+    for (i = 0; i < n; i++) {
+        struct sheap_node node = {
+            .data = &elements[i],
+            .priority.lli = elements[i].priority,
+        };
+
+        sheap_insert(&h, node);
+        elements[i].inserted = true;
+        /* Interleave removals with insertions, to merge
+         * the deletion buffer into new runs. */
+        if (i % 5 == 4) {
+            sequence_heap_check_pop(&h, elements, i + 1);
+        }
+    }
+
+    while (!sheap_is_empty(&h)) {
+        sequence_heap_check_pop(&h, elements, n);
+    }
+
+    free(elements);
+}
+
+static void
+test_sequence_heap(void)
+{
+    struct unit_test u = UNIT_INITIALIZER;
+    enum init_mode mode;
+
+    u.params = (struct unit_params) params;
+
+    if (verbose) {
+        printf("Running sequence heap geometry tests with %.0e elements:\n",
+               (double) u.params.n_elems);
+    }
+
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        u.params.mode = mode;
+        test_sequence_heap_(&u);
+    }
+}
+
+/* A run of equal priorities must not pin the day width
+ * to its minimum once priorities spread out again. */
+static void
+test_calendar_queue_spacing(void)
+{
+    unsigned int n = MAX(params.n_elems, 64);
+    struct cqueue_node *nodes;
+    struct cqueue_node *top;
+    long long int last;
+    struct cqueue q;
+    size_t i;
+
+    if (verbose) {
+        printf("Running calendar queue spacing tests with %.0e elements:\n",
+               (double) n);
+    }
+
+    cqueue_init(&q);
+    nodes = xcalloc(n, sizeof nodes[0]);
+
+    /* Two duplicates first, then priorities 1000 apart. */
+    cqueue_insert(&q, &nodes[0], 0);
+    cqueue_insert(&q, &nodes[1], 0);
+    for (i = 2; i < n; i++) {
+        cqueue_insert(&q, &nodes[i], (long long int) i * 1000);
+    }
+
+    last = LLONG_MIN;
+    for (i = 0; i < n - n / 8; i++) {
+        top = cqueue_pop(&q);
+        assert("Unexpected element removed." && top != NULL);
+        assert("Inconsistent sorting of keys." && top->prio >= last);
+        last = top->prio;
+    }
+    assert("Spacing stuck after duplicates." &&
+           mov_avg_ema(&q.spacing) > 100.);
+    assert("Day width stuck at its minimum." && q.width > 1);
+
+    while ((top = cqueue_pop(&q)) != NULL) {
+        assert("Inconsistent sorting of keys." && top->prio >= last);
+        last = top->prio;
+    }
+
+    free(nodes);
+}
+
+struct ttree_test_run {
+    struct element **e;
+    size_t head;
+    size_t n;
+};
+
+static bool
+ttree_test_cursor(void *aux, size_t run, struct ttree_node *n)
+{
+    struct ttree_test_run *r = &((struct ttree_test_run *) aux)[run];
+
+    if (r->head == r->n) {
+        return false;
+    }
+    n->data = r->e[r->head++];
+    n->priority.lli = ((struct element *) n->data)->priority;
+    return true;
+}
+
+static int
+ttree_test_node_cmp(struct ttree_node *a, struct ttree_node *b)
+{
+    return min_priority_cmp(a->priority.lli, b->priority.lli);
+}
+
+/* Order elements by priority, then by their position in the input. */
+static int
+element_ptr_cmp(const void *_a, const void *_b)
+{
+    const struct element * const *a = _a, * const *b = _b;
+    int c = min_priority_cmp((*a)->priority, (*b)->priority);
+
+    return c ? c : ((*a)->pos > (*b)->pos) - ((*a)->pos < (*b)->pos);
+}
+
+/* Merge 'n' elements spread over 'k' runs, the first one starting empty
+ * and receiving 'n_extra' more elements once half the merge is done. */
+static void
+test_tournament_tree_(size_t n, size_t k, enum init_mode mode)
+{
+    size_t n_extra = 10;
+    struct ttree_test_run *runs;
+    struct element *elements;
+    struct element **sorted;
+    struct element *e, *last = NULL;
+    struct ttree t;
+    size_t count = 0;
+    size_t i, start;
+    bool ok;
+
+    elements = xcalloc(n + n_extra, sizeof elements[0]);
+    sorted = xcalloc(n + n_extra, sizeof sorted[0]);
+    runs = xcalloc(k, sizeof runs[0]);
+    elements_init(elements, n, mode);
+
+    /* Runs are contiguous ranges of 'sorted', of random sizes. */
+    for (i = 0; i < n; i++) {
+        elements[i].pos = 1 + random_u32_range(k - 1);
+        runs[elements[i].pos].n++;
+    }
+    for (i = 1, start = 0; i < k; i++) {
+        runs[i].e = &sorted[start];
+        start += runs[i].n;
+    }
+    for (i = 0; i < n; i++) {
+        e = &elements[i];
+        runs[e->pos].e[runs[e->pos].head++] = e;
+    }
+    for (i = 0; i < k; i++) {
+        qsort(runs[i].e, runs[i].n, sizeof runs[i].e[0], element_ptr_cmp);
+        runs[i].head = 0;
+    }
+
+    /* Record the run of each element in its position,
+     * to check that equal keys are returned in run order. */
+    for (i = 1; i < k; i++) {
+        for (start = 0; start < runs[i].n; start++) {
+            runs[i].e[start]->pos = i * (n + n_extra) + start;
+        }
+    }
+
+    ok = ttree_init(&t, ttree_test_node_cmp, k, ttree_test_cursor, runs);
+    assert("Tournament tree initialization failed." && ok);
+
+    while ((e = ttree_next(&t)) != NULL) {
+        assert("Element removed twice." && !e->inserted);
+        assert("Inconsistent sorting of keys." &&
+               (last == NULL || element_ptr_cmp(&last, &e) < 0));
+        e->inserted = true;
+        last = e;
+
+        if (++count == n / 2) {
+            /* Refill the empty run with elements following 'last'. */
+            runs[0].e = &sorted[n];
+            runs[0].n = n_extra;
+            for (i = 0; i < n_extra; i++) {
+                sorted[n + i] = &elements[n + i];
+                elements[n + i].priority = last->priority + 1 + i;
+                elements[n + i].pos = i;
+            }
+            ttree_replace_run(&t, 0);
+        }
+    }
+    assert("Unexpected number of removal." &&
+           count == n + (n / 2 > 0 ? n_extra : 0));
+
+    ttree_finish(&t);
+    free(runs);
+    free(sorted);
+    free(elements);
+}
+
+static void
+test_tournament_tree(void)
+{
+    unsigned int n = params.n_elems;
+    enum init_mode mode;
+
+    if (verbose) {
+        printf("Running tournament tree tests with %.0e elements:\n",
+               (double) n);
+    }
+
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        test_tournament_tree_(n, 2, mode);
+        test_tournament_tree_(n, 3, mode);
+        test_tournament_tree_(n, 17, mode);
+        test_tournament_tree_(n, n / 4 + 2, mode);
+    }
+}
+
+/* Remove the lowest element of 'h', checking it against 'ref'. */
+static void
+test_external_heap_pop(struct eheap *h, struct bheap *ref,
+                       struct element *elements)
+{
+    struct element *e;
+    void *data;
+    bool ok;
+
+    ok = eheap_pop(h, &data);
+    assert("External heap emptied early." && ok);
+    e = &elements[(uintptr_t) data];
+    assert("Element removed twice." && !e->inserted);
+    ok = !bheap_is_empty(ref) &&
+         e->priority == ((struct element *) bheap_pop(ref))->priority;
+    assert("Inconsistent sorting of keys." && ok);
+    e->inserted = true;
+}
+
+/* Fill an external heap with 10 times its memory budget,
+ * checking its order against an in-memory binary heap. When
+ * 'interleave' is set, one element is removed every three insertions.
+ * Elements are stored as their index, handle 0 being NULL. */
+static void
+test_external_heap_(const char *dir, size_t budget, size_t block,
+                    enum init_mode mode, bool interleave)
+{
+    struct bheap ref = BHEAP_INITIALIZER(bheap_node_cmp);
+    size_t n = 10 * budget / sizeof(struct eheap_node);
+    struct element *elements;
+    struct eheap h;
+    size_t count = 0;
+    void *data;
+    bool ok;
+    size_t i;
+
+    elements = xcalloc(n, sizeof elements[0]);
+    elements_init(elements, n, mode);
+
+    ok = eheap_init(&h, dir, budget, block);
+    assert("External heap initialization failed." && ok);
+    assert("Insertion buffer exceeds the budget." &&
+           h.ins.bound * sizeof(struct bheap_node) < budget);
+
+    for (i = 0; i < n; i++) {
+        struct eheap_node node = {
+            .data = (void *) (uintptr_t) i,
+            .priority = elements[i].priority,
+        };
+
+        ok = eheap_insert(&h, node);
+        assert("Insertion failed." && ok);
+        bheap_insert(&ref, (struct bheap_node) {
+            .data = &elements[i], .priority.lli = elements[i].priority,
+        });
+
+        if (interleave && i % 3 == 2) {
+            test_external_heap_pop(&h, &ref, elements);
+            count++;
+        }
+    }
+
+    assert("No run was spilled." && !ttree_is_empty(&h.merge));
+
+    while (!eheap_is_empty(&h)) {
+        test_external_heap_pop(&h, &ref, elements);
+        count++;
+    }
+    assert("Pop succeeded on an empty heap." && !eheap_pop(&h, &data));
+    assert("Unexpected number of removal." && count == n);
+    assert("Unexpected I/O error." && h.error == 0);
+    assert("Reference heap not emptied." && bheap_is_empty(&ref));
+    for (i = 0; i < n; i++) {
+        assert("Element never removed." && elements[i].inserted);
+    }
+
+    eheap_destroy(&h);
+    free(elements);
+}
+
+static void
+test_external_heap(void)
+{
+    /* Prefer a tmpfs, to avoid wearing the disk. */
+    const char *dir = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp";
+    enum init_mode mode;
+
+    if (verbose) {
+        printf("Running external heap tests in %s:\n", dir);
+    }
+
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        /* Few runs, merged together often. */
+        test_external_heap_(dir, 64 << 10, 4 << 10, mode, false);
+        test_external_heap_(dir, 64 << 10, 4 << 10, mode, true);
+        /* Many runs of small blocks. */
+        test_external_heap_(dir, 64 << 10, 256, mode, true);
+    }
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static int
+pheap_element_cmp(struct pheap_node *a, struct pheap_node *b)
+{
+    return min_priority_cmp(container_of(a, struct element, hnode)->priority,
+                            container_of(b, struct element, hnode)->priority);
+}
+
+ALLOW_UNDEFINED_BEHAVIOR
+static int
+fheap_element_cmp(struct fheap_node *a, struct fheap_node *b)
+{
+    return min_priority_cmp(container_of(a, struct element, fnode)->priority,
+                            container_of(b, struct element, fnode)->priority);
+}
+
+static void
+check_pheap_stats(struct pheap *h, size_t n)
+{
+    struct pheap_stats s;
+
+    pheap_stats(h, &s);
+    assert("Wrong number of nodes." && s.n == n && h->counters.n == n);
+    assert("Inconsistent degrees." &&
+           s.root_degree <= s.max_degree && s.max_degree < MAX(n, 1));
+    assert("Inconsistent depth." && s.depth < MAX(n, 1));
+}
+
+static void
+check_fheap_stats(struct fheap *h, size_t n)
+{
+    struct fheap_stats s;
+    size_t count = 0;
+    size_t i;
+
+    fheap_stats(h, &s);
+    for (i = 0; i < ARRAY_SIZE(s.ranks); i++) {
+        count += s.ranks[i];
+    }
+    assert("Wrong number of nodes." &&
+           s.n == n && count == n && h->counters.n == n);
+    assert("Wrong root list length." && s.n_roots == h->counters.n_roots);
+    assert("Inconsistent depth." && s.depth < MAX(n, 1));
+}
+
+static void
+check_bheap_stats(struct bheap *h)
+{
+    struct bheap_stats s;
+
+    bheap_stats(h, &s);
+    assert("Wrong number of entries." && s.n == h->n);
+    assert("Wrong number of burnt entries." &&
+           s.n_invalid == h->counters.n_invalid && s.n_invalid <= s.n);
+    assert("Inconsistent capacity." && s.slack <= h->capacity);
+    assert("Inconsistent depth." &&
+           (s.n == 0 ? s.depth == 0 : (1ULL << (s.depth - 1)) <= s.n));
+}
+
+/* Go through insertions, key updates and removals, comparing
+ * the statistics of the heaps with their expected shape. */
+ALLOW_UNDEFINED_BEHAVIOR
+static void
+test_heap_stats_(unsigned int n, enum init_mode mode)
+{
+    struct pheap ph = PHEAP_INITIALIZER(pheap_element_cmp);
+    struct fheap fh = FHEAP_INITIALIZER(fheap_element_cmp);
+    struct bheap bh = BHEAP_INITIALIZER(bheap_node_cmp);
+    struct element *elements;
+    struct element *copies;
+    struct fheap_node *fn;
+    struct bheap_stats bs;
+    struct element *e[2];
+    size_t i;
+
+    elements = xcalloc(n, sizeof elements[0]);
+    copies = xcalloc(n, sizeof copies[0]);
+    elements_init(elements, n, mode);
+    memcpy(copies, elements, n * sizeof elements[0]);
+
+    /* Intrusive nodes share their place within elements,
+     * the fibonacci heap uses copies. */
+    for (i = 0; i < n; i++) {
+        pheap_insert(&ph, &elements[i].hnode);
+        fheap_insert(&fh, &copies[i].fnode);
+        bheap_insert(&bh, (struct bheap_node) {
+            .data = &elements[i], .priority.lli = elements[i].priority,
+        });
+    }
+    check_pheap_stats(&ph, n);
+    check_fheap_stats(&fh, n);
+    check_bheap_stats(&bh);
+
+    /* Consolidate the fibonacci heap before updating keys,
+     * for cuts to happen. The element is put back. */
+    fn = fheap_pop(&fh);
+    fheap_insert(&fh, fn);
+
+    for (i = 0; i < n; i += 4) {
+        elements[i].priority /= 2;
+        copies[i].priority = elements[i].priority;
+        pheap_reinsert(&ph, &elements[i].hnode);
+        fheap_update_key(&fh, &copies[i].fnode);
+        bheap_update_key(&bh, (struct bheap_node) {
+            .data = &elements[i], .priority.lli = elements[i].priority,
+        });
+    }
+    check_pheap_stats(&ph, n);
+    check_fheap_stats(&fh, n);
+    check_bheap_stats(&bh);
+    bheap_stats(&bh, &bs);
+    assert("Key updates did not burn entries." &&
+           bs.n_invalid == (n + 3) / 4 && bs.n == n + bs.n_invalid);
+
+    for (i = n; i > 0; i--) {
+        e[0] = container_of(pheap_pop(&ph), struct element, hnode);
+        e[1] = container_of(fheap_pop(&fh), struct element, fnode);
+        assert("Inconsistent sorting of keys." &&
+               e[0]->priority == e[1]->priority);
+        bheap_pop(&bh);
+        check_pheap_stats(&ph, i - 1);
+        check_fheap_stats(&fh, i - 1);
+        check_bheap_stats(&bh);
+    }
+    /* Burnt entries are left until the next removal. */
+    assert("Unexpected element left." && bheap_pop(&bh) == NULL);
+    bheap_stats(&bh, &bs);
+    assert("Binary heap not emptied." && bs.n == 0 && bs.n_invalid == 0);
+
+    free(copies);
+    free(elements);
+}
+
+static void
+test_heap_stats(void)
+{
+    unsigned int n = MIN(params.n_elems, 1000);
+    enum init_mode mode;
+
+    if (verbose) {
+        printf("Running statistics tests with %.0e elements:\n", (double) n);
+    }
+
+    for (mode = INCREASING; mode < N_MODES; mode++) {
+        test_heap_stats_(1, mode);
+        test_heap_stats_(n, mode);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     if (parse_params(argc, argv, &params) < 0) {
@@ -339,23 +1184,66 @@ int main(int argc, char *argv[])
         printf("Using seed: %u\n", params.seed);
     }
 
-    test_insertion(&min_pairing_heap);
-    test_modify_key(&min_pairing_heap);
+    test_insertion(&min_pairing_heap_counted);
+    test_modify_key(&min_pairing_heap_counted);
+    test_peek_k(&min_pairing_heap_counted);
+
+    test_insertion(&max_pairing_heap_counted);
+    test_modify_key(&max_pairing_heap_counted);
+    test_peek_k(&max_pairing_heap_counted);
+
+    test_insertion(&min_binary_heap_counted);
+    test_modify_key(&min_binary_heap_counted);
+    test_peek_k(&min_binary_heap_counted);
+
+    test_insertion(&max_binary_heap_counted);
+    test_modify_key(&max_binary_heap_counted);
+    test_peek_k(&max_binary_heap_counted);
+
+    test_insertion(&min_paged_binary_heap_counted);
+    test_modify_key(&min_paged_binary_heap_counted);
+    test_peek_k(&min_paged_binary_heap_counted);
+
+    test_insertion(&max_paged_binary_heap_counted);
+    test_modify_key(&max_paged_binary_heap_counted);
+    test_peek_k(&max_paged_binary_heap_counted);
+
+    test_binary_heap_merge();
+    test_binary_heap_top_k();
+
+    test_insertion(&min_fibonacci_heap_counted);
+    test_modify_key(&min_fibonacci_heap_counted);
+    test_peek_k(&min_fibonacci_heap_counted);
+
+    test_insertion(&max_fibonacci_heap_counted);
+    test_modify_key(&max_fibonacci_heap_counted);
+    test_peek_k(&max_fibonacci_heap_counted);
+
+    test_insertion(&min_calendar_queue_counted);
+    test_modify_key(&min_calendar_queue_counted);
+
+    test_insertion(&max_calendar_queue_counted);
+    test_modify_key(&max_calendar_queue_counted);
+
+    test_insertion(&min_minmax_heap_counted);
+    test_modify_key(&min_minmax_heap_counted);
+    test_double_ended(&min_minmax_heap_counted);
+
+    test_insertion(&max_minmax_heap_counted);
+    test_modify_key(&max_minmax_heap_counted);
+    test_double_ended(&max_minmax_heap_counted);
 
-    test_insertion(&max_pairing_heap);
-    test_modify_key(&max_pairing_heap);
+    test_insertion(&min_sequence_heap_counted);
+    test_insertion(&max_sequence_heap_counted);
+    test_sequence_heap();
 
-    test_insertion(&min_binary_heap);
-    test_modify_key(&min_binary_heap);
+    test_calendar_queue_spacing();
 
-    test_insertion(&max_binary_heap);
-    test_modify_key(&max_binary_heap);
+    test_tournament_tree();
 
-    test_insertion(&min_fibonacci_heap);
-    test_modify_key(&min_fibonacci_heap);
+    test_external_heap();
 
-    test_insertion(&max_fibonacci_heap);
-    test_modify_key(&max_fibonacci_heap);
+    test_heap_stats();
 
     if (verbose) {
         printf("Test succeeded.\n");
@@ -12,7 +12,7 @@
 
 #include "util.h"
 
-uint32_t rand_seed;
+_Thread_local uint32_t rand_seed;
 
 void
 xabort(const char *msg)
@@ -91,6 +91,15 @@ time_usec(void)
     return timespec_to_usec(&ts);
 }
 
+long long int
+time_nsec(void)
+{
+    struct timespec ts;
+
+    xclock_gettime(&ts);
+    return (long long int) ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
 bool
 str_to_uint(const char *s, int base, unsigned int *result)
 {
@@ -31,7 +31,8 @@
 #define MAX(a, b) (a > b ? a : b)
 #define MIN(a, b) (a < b ? a : b)
 
-extern uint32_t rand_seed;
+/* Each thread draws its own sequence. */
+extern _Thread_local uint32_t rand_seed;
 
 /* The state word must be initialized to non-zero */
 static inline uint32_t
@@ -99,6 +100,7 @@ void *xmalloc(size_t size);
 
 long long int time_msec(void);
 long long int time_usec(void);
+long long int time_nsec(void);
 
 bool str_to_uint(const char *s, int base, unsigned int *result);
 
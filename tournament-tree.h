@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2022 Gaëtan Rivet
+ */
+
+#ifndef _TOURNAMENT_TREE_H_
+#define _TOURNAMENT_TREE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Tournament tree.
+ *
+ * This is a loser tree, merging 'k' sorted runs into a single
+ * sorted stream, as described by D. Knuth in TAOCP vol. 3, 5.4.1.
+ *
+ * Each run is read through a cursor: a function called with the
+ * run index, writing its next container. Like the binary heap,
+ * containers point to arbitrary data and keep a priority value within.
+ *
+ * Each internal node of the tree keeps the loser of the match
+ * played between its two subtrees, the overall winner being kept
+ * apart. Once the winner is consumed, its run provides its next
+ * element, which only plays against the losers on its path to the
+ * root: log(k) comparisons, without looking at siblings.
+ *
+ * Exhausted runs lose against all others. Elements comparing equal
+ * are returned in the order of their run index, making the merge stable.
+ *
+ * Memory is allocated once on init, for 'k' runs,
+ * and released by 'finish'.
+ */
+
+struct ttree_node {
+    void *data;
+    union {
+        uint32_t u32;
+        long long int lli;
+    } priority;
+};
+
+typedef int (*ttree_cmp)(struct ttree_node *a, struct ttree_node *b);
+
+/* Write the next container of run 'run' in 'n'.
+ * Returns false once the run is exhausted. */
+typedef bool (*ttree_cursor)(void *aux, size_t run, struct ttree_node *n);
+
+struct ttree_leaf {
+    struct ttree_node node;
+    bool exhausted;
+};
+
+struct ttree {
+    ttree_cmp cmp;
+    ttree_cursor cursor;
+    void *aux;
+    size_t k;
+    /* Current head of each run. */
+    struct ttree_leaf *leaves;
+    /* Run index of the loser of each internal node,
+     * the winner being at index 0. */
+    size_t *losers;
+};
+
+#define TTREE_INITIALIZER(CMP) { \
+    .cmp = CMP, .cursor = NULL, .aux = NULL, \
+    .k = 0, .leaves = NULL, .losers = NULL, \
+}
+
+/* Tournament tree interface. */
+
+/* Start merging 'k' runs read through 'cursor', called with 'aux'.
+ * Returns false if memory could not be allocated. */
+static inline bool ttree_init(struct ttree *t, ttree_cmp cmp, size_t k,
+                              ttree_cursor cursor, void *aux);
+/* Returns 'true' once all runs are exhausted. */
+static inline bool ttree_is_empty(struct ttree *t);
+static inline void *ttree_peek(struct ttree *t);
+/* Returns the next element of the merge, NULL once all runs are exhausted. */
+static inline void *ttree_next(struct ttree *t);
+/* Run 'run' has been replaced by the caller, e.g. an exhausted run
+ * received new elements: read its head again from the cursor.
+ * The previous head of the run is dropped. */
+static inline void ttree_replace_run(struct ttree *t, size_t run);
+/* Release the memory used by the tree. */
+static inline void ttree_finish(struct ttree *t);
+
+/* Utility functions, used to implement
+ * the above operations. Do not call directly. */
+
+/* Returns true if run 'a' wins over run 'b'. */
+static inline bool
+ttree_beats(struct ttree *t, size_t a, size_t b)
+{
+    struct ttree_leaf *la = &t->leaves[a];
+    struct ttree_leaf *lb = &t->leaves[b];
+    int c;
+
+    if (la->exhausted || lb->exhausted) {
+        return lb->exhausted && (!la->exhausted || a < b);
+    }
+
+    c = t->cmp(&la->node, &lb->node);
+    return c < 0 || (c == 0 && a < b);
+}
+
+static inline void
+ttree_read(struct ttree *t, size_t run)
+{
+    struct ttree_leaf *l = &t->leaves[run];
+
+    l->exhausted = !t->cursor(t->aux, run, &l->node);
+}
+
+/* Play the matches of the subtree rooted at internal node 'x',
+ * leaves being numbered from 'k' to '2k - 1'. Returns the winner. */
+static inline size_t
+ttree_build(struct ttree *t, size_t x)
+{
+    size_t a, b;
+
+    if (x >= t->k) {
+        return x - t->k;
+    }
+
+    a = ttree_build(t, 2 * x);
+    b = ttree_build(t, 2 * x + 1);
+    if (ttree_beats(t, a, b)) {
+        t->losers[x] = b;
+        return a;
+    }
+    t->losers[x] = a;
+    return b;
+}
+
+/* Replay the matches on the path of 'run' to the root. */
+static inline void
+ttree_replay(struct ttree *t, size_t run)
+{
+    size_t winner = run;
+    size_t x, tmp;
+
+    for (x = (run + t->k) / 2; x > 0; x /= 2) {
+        if (ttree_beats(t, t->losers[x], winner)) {
+            tmp = t->losers[x];
+            t->losers[x] = winner;
+            winner = tmp;
+        }
+    }
+    t->losers[0] = winner;
+}
+
+static inline bool
+ttree_init(struct ttree *t, ttree_cmp cmp, size_t k,
+           ttree_cursor cursor, void *aux)
+{
+    size_t i;
+
+    *t = (struct ttree) TTREE_INITIALIZER(cmp);
+    t->cursor = cursor;
+    t->aux = aux;
+
+    if (k == 0) {
+        return true;
+    }
+
+    t->leaves = malloc(k * sizeof t->leaves[0]);
+    t->losers = malloc(k * sizeof t->losers[0]);
+    if (t->leaves == NULL || t->losers == NULL) {
+        ttree_finish(t);
+        return false;
+    }
+    t->k = k;
+
+    for (i = 0; i < k; i++) {
+        ttree_read(t, i);
+    }
+    t->losers[0] = ttree_build(t, 1);
+
+    return true;
+}
+
+static inline bool
+ttree_is_empty(struct ttree *t)
+{
+    return t->k == 0 || t->leaves[t->losers[0]].exhausted;
+}
+
+static inline void *
+ttree_peek(struct ttree *t)
+{
+    return ttree_is_empty(t) ? NULL : t->leaves[t->losers[0]].node.data;
+}
+
+static inline void *
+ttree_next(struct ttree *t)
+{
+    size_t run;
+    void *data;
+
+    if (ttree_is_empty(t)) {
+        return NULL;
+    }
+
+    run = t->losers[0];
+    data = t->leaves[run].node.data;
+    ttree_read(t, run);
+    ttree_replay(t, run);
+
+    return data;
+}
+
+static inline void
+ttree_replace_run(struct ttree *t, size_t run)
+{
+    if (run >= t->k) {
+        return;
+    }
+
+    ttree_read(t, run);
+    if (run == t->losers[0]) {
+        ttree_replay(t, run);
+    } else {
+        /* The run may have lost anywhere on its path,
+         * its matches cannot be replayed alone. */
+        t->losers[0] = ttree_build(t, 1);
+    }
+}
+
+static inline void
+ttree_finish(struct ttree *t)
+{
+    free(t->leaves);
+    free(t->losers);
+    t->leaves = NULL;
+    t->losers = NULL;
+    t->k = 0;
+}
+
+#endif /* _TOURNAMENT_TREE_H_ */